@@ -0,0 +1,379 @@
+//agg.c
+//집계; 한 줄에 정수 하나씩 있는 큰 파일의 합, 곱, 최댓값, 최솟값을 스레드로 나눠 구한다
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "bigint.h"
+
+
+/*
+ * 스레드 몫; 파일을 줄 경계에서 잘라 나눠 갖고, 읽으면서 바로 더하고 곱한다.
+ * 18자리 이하는 워드로 처리하고 그보다 긴 숫자만 bigint를 만든다
+ */
+
+#define AGG_SHORT 18
+
+#define AGG_SUM 1
+#define AGG_PROD 2
+#define AGG_MAX 4
+#define AGG_MIN 8
+
+typedef struct
+{
+  // 파일 안의 숫자; 앞의 0과 부호를 뺀 자리 (len이 0이면 아직 없음)
+  const char *ptr;
+  uint64_t len;
+  uint8_t sign;
+} agg_span_t;
+
+typedef struct
+{
+  const char *lo;
+  const char *hi;
+  uint8_t ops;
+  pthread_t thread;
+
+  // 합: 짧은 숫자는 부호별 128비트 합, 긴 숫자는 누산기
+  unsigned __int128 pos;
+  unsigned __int128 neg;
+  amhbi_acc_t *acc;
+
+  // 곱: 워드가 넘칠 때마다 이진 카운터처럼 비슷한 크기끼리 곱해 올린다
+  uint64_t word;
+  amhbi_t *levels[64];
+  amhbi_t *prod;
+  uint64_t negs;
+  uint8_t zero;
+
+  agg_span_t max;
+  agg_span_t min;
+  uint64_t lines;
+  uint64_t errors;
+  char *buf;
+  uint64_t bufcap;
+} agg_part_t;
+
+
+static uint64_t
+agg_now ()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+static int
+agg_cmp (agg_span_t *a, agg_span_t *b)
+{
+  // 부호, 자리수, 자리 순으로; 음수는 뒤집는다
+  if (a->sign != b->sign) return (a->sign) ? -1 : 1;
+  int res = (a->len != b->len) ? ((a->len < b->len) ? -1 : 1) : memcmp(a->ptr, b->ptr, a->len);
+  return (a->sign) ? -res : res;
+}
+
+
+static void
+agg_push (agg_part_t *part, amhbi_t *num)
+{
+  // 같은 칸에 이미 있으면 곱해서 한 칸 위로
+  uint64_t k; for (k = 0; part->levels[k]; k++) {
+    amhbi_t *tmp = amhbi_mult(part->levels[k], num);
+    amhbi_free(2, part->levels[k], num);
+    part->levels[k] = NULL;
+    num = tmp;
+  }
+  part->levels[k] = num;
+}
+
+
+static amhbi_t *
+agg_u128 (unsigned __int128 val)
+{
+  char str[48];
+  char *pos = &str[sizeof(str) - 1];
+  *pos = 0;
+  do {
+    *--pos = '0' + (val % 10);
+    val /= 10;
+  } while (val);
+  return amhbi_init_str(pos);
+}
+
+
+static amhbi_t *
+agg_long (agg_part_t *part, agg_span_t *num)
+{
+  // mmap한 자리는 0으로 끝나지 않으므로 복사해서 만든다
+  if (num->len + 1 > part->bufcap) {
+    part->bufcap = 2 * num->len + 1;
+    part->buf = realloc(part->buf, part->bufcap);
+    assert(part->buf);
+  }
+  memcpy(part->buf, num->ptr, num->len);
+  part->buf[num->len] = 0;
+  return amhbi_init_str(part->buf);
+}
+
+
+static void *
+agg_worker (void *arg)
+{
+  agg_part_t *part = arg;
+  const char *p = part->lo, *hi = part->hi;
+  uint8_t ops = part->ops;
+  part->word = 1;
+  if (ops & AGG_SUM) part->acc = amhbi_acc_init();
+
+  while (p < hi) {
+    // 공백, 부호, 앞의 0 (한 자리는 남긴다)
+    while (p < hi && (*p == ' ' || *p == '\t')) p++;
+    agg_span_t num = {NULL, 0, 0};
+    uint8_t mark = 0;
+    if (p < hi && (*p == '-' || *p == '+')) {
+      num.sign = (*p++ == '-');
+      mark = 1;
+    }
+    while (p + 1 < hi && *p == '0' && (uint8_t)(p[1] - '0') < 10) p++;
+
+    // 자리를 읽으면서 짧으면 바로 워드로
+    num.ptr = p;
+    uint64_t val = 0;
+    while (p < hi && (uint8_t)(*p - '0') < 10) {
+      if (p - num.ptr < AGG_SHORT) val = val * 10 + (*p - '0');
+      p++;
+    }
+    num.len = p - num.ptr;
+    while (p < hi && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+
+    // 줄 끝이 아니거나 부호('+' 포함)만 있으면 오류, 빈 줄은 건너뛴다
+    if ((p < hi && *p != '\n') || (!num.len && mark)) {
+      const char *end = memchr(p, '\n', hi - p);
+      p = (end) ? end + 1 : hi;
+      part->errors++;
+      continue;
+    }
+    p++;
+    if (!num.len) continue;
+    if (num.len == 1 && *num.ptr == '0') num.sign = 0;
+    part->lines++;
+
+    if (ops & (AGG_MAX | AGG_MIN)) {
+      if (!part->max.len || agg_cmp(&num, &part->max) > 0) part->max = num;
+      if (!part->min.len || agg_cmp(&num, &part->min) < 0) part->min = num;
+    }
+    if (num.len <= AGG_SHORT) {
+      if (ops & AGG_SUM) {
+        if (num.sign) part->neg += val;
+        else part->pos += val;
+      }
+      if ((ops & AGG_PROD) && !part->zero) {
+        uint64_t tmp;
+        part->negs += num.sign;
+        if (!val) part->zero = 1;
+        else if (__builtin_mul_overflow(part->word, val, &tmp)) {
+          agg_push(part, amhbi_init_uint(part->word));
+          part->word = val;
+        } else {
+          part->word = tmp;
+        }
+      }
+    } else if (ops & (AGG_SUM | AGG_PROD)) {
+      amhbi_t *big = agg_long(part, &num);
+      if (ops & AGG_SUM) {
+        if (num.sign) amhbi_acc_sub(part->acc, big);
+        else amhbi_acc_add(part->acc, big);
+      }
+      if ((ops & AGG_PROD) && !part->zero) {
+        part->negs += num.sign;
+        big->sign = 0;
+        agg_push(part, big);
+      } else {
+        amhbi_free(1, big);
+      }
+    }
+  }
+
+  // 워드로 모은 합을 누산기에, 남은 칸들을 낮은 칸부터 곱한다
+  if (ops & AGG_SUM) {
+    amhbi_t *pos = agg_u128(part->pos), *neg = agg_u128(part->neg);
+    amhbi_acc_add(part->acc, pos);
+    amhbi_acc_sub(part->acc, neg);
+    amhbi_free(2, pos, neg);
+  }
+  if (ops & AGG_PROD) {
+    part->prod = amhbi_init_uint(part->word);
+    uint64_t k; for (k = 0; k < 64; k++) {
+      if (!part->levels[k]) continue;
+      amhbi_t *tmp = amhbi_mult(part->levels[k], part->prod);
+      amhbi_free(2, part->levels[k], part->prod);
+      part->prod = tmp;
+    }
+  }
+  free(part->buf);
+  return NULL;
+}
+
+
+/*
+ * 트리 합치기; 단계마다 간격 step만큼 떨어진 몫을 둘씩 합치고, 짝마다
+ * 스레드를 하나씩 써서 큰 곱도 나란히 한다
+ */
+
+typedef struct
+{
+  agg_part_t *a;
+  agg_part_t *b;
+  pthread_t thread;
+} agg_merge_t;
+
+
+static void *
+agg_merge (void *arg)
+{
+  agg_merge_t *job = arg;
+  agg_part_t *a = job->a, *b = job->b;
+  if (a->acc) {
+    amhbi_acc_merge(a->acc, b->acc);
+    amhbi_acc_free(b->acc);
+  }
+  if (a->prod) {
+    amhbi_t *tmp = amhbi_mult(a->prod, b->prod);
+    amhbi_free(2, a->prod, b->prod);
+    a->prod = tmp;
+  }
+  if (b->max.len && (!a->max.len || agg_cmp(&b->max, &a->max) > 0)) a->max = b->max;
+  if (b->min.len && (!a->min.len || agg_cmp(&b->min, &a->min) < 0)) a->min = b->min;
+  a->negs += b->negs;
+  a->zero |= b->zero;
+  a->lines += b->lines;
+  a->errors += b->errors;
+  return NULL;
+}
+
+
+static void
+agg_print (const char *name, agg_span_t *num)
+{
+  printf("%s ", name);
+  if (!num->len) printf("none\n");
+  else printf("%s%.*s\n", (num->sign) ? "-" : "", (int)num->len, num->ptr);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  // 옵션: 스레드 수와 구할 값들 (없으면 합, 최댓값, 최솟값)
+  uint64_t threads = sysconf(_SC_NPROCESSORS_ONLN);
+  uint8_t ops = 0;
+  const char *path = NULL;
+  uint8_t bad = 0;
+  int i; for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = strtoull(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--sum")) ops |= AGG_SUM;
+    else if (!strcmp(argv[i], "--prod")) ops |= AGG_PROD;
+    else if (!strcmp(argv[i], "--max")) ops |= AGG_MAX;
+    else if (!strcmp(argv[i], "--min")) ops |= AGG_MIN;
+    else if (!path && argv[i][0] != '-') path = argv[i];
+    else bad = 1;
+  }
+  if (bad || !path || !threads) {
+    fprintf(stderr, "usage: %s [--threads n] [--sum] [--prod] [--max] [--min] file\n", argv[0]);
+    return 1;
+  }
+  if (!ops) ops = AGG_SUM | AGG_MAX | AGG_MIN;
+
+  // 파일 전체를 매핑
+  uint64_t start = agg_now();
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    perror(path);
+    return 1;
+  }
+  uint64_t size = st.st_size;
+  const char *data = "";
+  if (size) {
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    madvise((void *)data, size, MADV_SEQUENTIAL);
+  }
+
+  // 나눈 자리에서 다음 줄 첫 글자로 옮긴다
+  if (threads > size / 4096 + 1) threads = size / 4096 + 1;
+  agg_part_t *parts = calloc(threads, sizeof(agg_part_t));
+  assert(parts);
+  const char *end = data + size;
+  const char *lo = data;
+  uint64_t t; for (t = 0; t < threads; t++) {
+    const char *hi = (t + 1 == threads) ? end : data + size / threads * (t + 1);
+    if (hi < lo) hi = lo;
+    const char *nl = (hi < end) ? memchr(hi, '\n', end - hi) : NULL;
+    if (t + 1 < threads) hi = (nl) ? nl + 1 : end;
+    parts[t].lo = lo;
+    parts[t].hi = hi;
+    parts[t].ops = ops;
+    lo = hi;
+  }
+  for (t = 0; t < threads; t++) pthread_create(&parts[t].thread, NULL, agg_worker, &parts[t]);
+  for (t = 0; t < threads; t++) pthread_join(parts[t].thread, NULL);
+  uint64_t parsed = agg_now();
+
+  // 트리 합치기
+  agg_merge_t *jobs = calloc(threads, sizeof(agg_merge_t));
+  assert(jobs);
+  uint64_t step; for (step = 1; step < threads; step *= 2) {
+    uint64_t n = 0;
+    for (t = 0; t + step < threads; t += 2 * step) {
+      jobs[n].a = &parts[t];
+      jobs[n].b = &parts[t + step];
+      pthread_create(&jobs[n].thread, NULL, agg_merge, &jobs[n]);
+      n++;
+    }
+    for (t = 0; t < n; t++) pthread_join(jobs[t].thread, NULL);
+  }
+  free(jobs);
+
+  // 결과; 곱의 부호는 음수 개수로 정한다
+  agg_part_t *res = &parts[0];
+  printf("lines %llu\n", (unsigned long long)res->lines);
+  if (ops & AGG_SUM) {
+    amhbi_t *sum = amhbi_acc_get(res->acc);
+    char *str = amhbi_to_str(sum);
+    printf("sum %s\n", str);
+    free(str);
+    amhbi_free(1, sum);
+    amhbi_acc_free(res->acc);
+  }
+  if (ops & AGG_PROD) {
+    if (res->zero) {
+      printf("prod 0\n");
+    } else {
+      res->prod->sign = res->negs % 2;
+      char *str = amhbi_to_str(res->prod);
+      printf("prod %s\n", str);
+      free(str);
+    }
+    amhbi_free(1, res->prod);
+  }
+  if (ops & AGG_MAX) agg_print("max", &res->max);
+  if (ops & AGG_MIN) agg_print("min", &res->min);
+  fflush(stdout);
+  uint64_t done = agg_now();
+
+  // 처리량; 배치 노드 크기를 정할 때 쓴다
+  double secs = (done - start) / 1e9;
+  fprintf(stderr, "%llu lines (%llu errors), %.1f MB, %llu threads: parse %.3f s, merge %.3f s, "
+    "total %.3f s; %.1f MB/s, %.2f M lines/s\n", (unsigned long long)res->lines,
+    (unsigned long long)res->errors, size / 1e6, (unsigned long long)threads,
+    (parsed - start) / 1e9, (done - parsed) / 1e9, secs, size / 1e6 / secs, res->lines / 1e6 / secs);
+
+  if (size) munmap((void *)data, size);
+  close(fd);
+  free(parts);
+  return 0;
+}
@@ -0,0 +1,210 @@
+//bench.c
+//벤치마크; 연산별로 크기를 바꿔가며 시간과 할당 횟수를 잰다
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <time.h>
+#include "bigint.h"
+
+
+/*
+ * Allocation counting; the bench target links with --wrap so that every
+ * allocation made by the library goes through these
+ */
+
+static uint64_t bench_allocs = 0;
+
+void *__real_malloc (size_t size);
+void *__real_calloc (size_t n, size_t size);
+void *__real_realloc (void *ptr, size_t size);
+
+
+void *
+__wrap_malloc (size_t size)
+{
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+
+void *
+__wrap_calloc (size_t n, size_t size)
+{
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __real_calloc(n, size);
+}
+
+
+void *
+__wrap_realloc (void *ptr, size_t size)
+{
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+
+
+/*
+ * Operations; each is run on operands of the sweep size, up to its own
+ * largest size while it is too slow for more
+ */
+
+typedef enum
+{
+  BENCH_ADD, BENCH_MULT, BENCH_QUO, BENCH_REM, BENCH_POW, BENCH_GCD,
+  BENCH_INIT_STR, BENCH_TO_STR, BENCH_OPS
+} bench_op_t;
+
+static const char *bench_names[BENCH_OPS] = {
+  "add", "mult", "quo", "rem", "pow", "gcd", "init_str", "to_str"
+};
+
+static const uint64_t bench_max[BENCH_OPS] = {
+  10000000, 10000000, 10000000, 10000000, 10000000, 10000, 10000000, 10000000
+};
+
+
+static uint64_t
+bench_now ()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+static int
+bench_cmp (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+
+static amhbi_t *
+bench_operand (amhbi_rand_t *rand, uint64_t digits)
+{
+  // 정확히 digits 자리인 난수
+  amhbi_t *num = amhbi_urandomd(rand, digits);
+  while (amhbi_size(num) < digits) {
+    amhbi_free(1, num);
+    num = amhbi_urandomd(rand, digits);
+  }
+  return num;
+}
+
+
+static void
+bench_run (bench_op_t op, amhbi_t *a, amhbi_t *b, amhbi_t *e, char *str)
+{
+  amhbi_t *res = NULL;
+  char *out = NULL;
+  switch (op) {
+    case BENCH_ADD: res = amhbi_add(a, b); break;
+    case BENCH_MULT: res = amhbi_mult(a, b); break;
+    case BENCH_QUO: res = amhbi_quo(a, b); break;
+    case BENCH_REM: res = amhbi_rem(a, b); break;
+    case BENCH_POW: res = amhbi_pow(a, e); break;
+    case BENCH_GCD: res = amhbi_gcd(a, b); break;
+    case BENCH_INIT_STR: res = amhbi_init_str(str); break;
+    case BENCH_TO_STR: out = amhbi_to_str(a); break;
+    default: break;
+  }
+  if (res) amhbi_free(1, res);
+  free(out);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  // 옵션: 최대 자리수, 최소 반복 횟수, 사용할 CPU, 스레드 수, JSON 파일
+  uint64_t max = 10000000;
+  uint64_t reps = 5;
+  int cpu = 0;
+  uint64_t threads = 1;
+  const char *json = NULL;
+  int i; for (i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--max")) max = strtoull(argv[i + 1], NULL, 10);
+    else if (!strcmp(argv[i], "--reps")) reps = strtoull(argv[i + 1], NULL, 10);
+    else if (!strcmp(argv[i], "--cpu")) cpu = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--threads")) threads = strtoull(argv[i + 1], NULL, 10);
+    else if (!strcmp(argv[i], "--json")) json = argv[i + 1];
+  }
+  if (i < argc) {
+    fprintf(stderr, "usage: %s [--max digits] [--reps n] [--cpu k] [--threads n] [--json file]\n", argv[0]);
+    return 1;
+  }
+
+  // 스레드 고정; 라이브러리가 만드는 스레드도 같은 CPU 집합을 물려받는다
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  uint64_t t; for (t = 0; t < threads; t++) CPU_SET(cpu + t, &set);
+  if (sched_setaffinity(0, sizeof(set), &set)) perror("sched_setaffinity");
+  amhbi_set_threads(threads);
+
+  FILE *out = (json) ? fopen(json, "w") : stdout;
+  assert(out);
+  fprintf(out, "{\"threads\": %llu, \"cpu\": %d, \"results\": [", (unsigned long long)threads, cpu);
+  fprintf(stderr, "%-9s %9s %7s %14s %14s %10s\n", "op", "digits", "reps", "median ns", "p99 ns", "allocs/op");
+
+  // 크기: 10, 30, 100, 300, ... max
+  amhbi_rand_t *rand = amhbi_rand_init(1);
+  uint8_t first = 1;
+  uint64_t size; for (size = 10; size <= max; size = (size % 3) ? size * 3 : size / 3 * 10) {
+    amhbi_t *a = bench_operand(rand, size);
+    amhbi_t *b = bench_operand(rand, size);
+    amhbi_t *wide = bench_operand(rand, 2 * size);
+    amhbi_t *base = bench_operand(rand, (size >= 100) ? size / 10 : 1);
+    amhbi_t *ten = amhbi_init_int(10);
+    char *str = amhbi_to_str(a);
+
+    bench_op_t op; for (op = 0; op < BENCH_OPS; op++) {
+      if (size > bench_max[op]) continue;
+
+      // 나눗셈은 2n / n 자리, 거듭제곱은 (n / 10 자리)^10
+      amhbi_t *x = (op == BENCH_QUO || op == BENCH_REM) ? wide : (op == BENCH_POW) ? base : a;
+
+      // 한 번의 측정이 10us 이상 걸리도록 묶어서 실행
+      uint64_t batch = 1;
+      uint64_t start = bench_now();
+      bench_run(op, x, b, ten, str);
+      uint64_t once = bench_now() - start;
+      if (once < 10000) batch = 10000 / (once + 1) + 1;
+
+      // 최소 reps 번, 모두 합쳐 0.2초가 될 때까지 (최대 1000번)
+      uint64_t cap = 1000;
+      uint64_t *samples = malloc(cap * sizeof(uint64_t));
+      uint64_t count = 0, total = 0;
+      uint64_t allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+      while (count < cap && (count < reps || total < 200000000ULL)) {
+        start = bench_now();
+        uint64_t k; for (k = 0; k < batch; k++) bench_run(op, x, b, ten, str);
+        uint64_t elapsed = bench_now() - start;
+        samples[count++] = elapsed / batch;
+        total += elapsed;
+      }
+      allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED) - allocs;
+
+      qsort(samples, count, sizeof(uint64_t), bench_cmp);
+      uint64_t median = samples[count / 2];
+      uint64_t p99 = samples[(count * 99 + 99) / 100 - 1];
+      double per = (double)allocs / (count * batch);
+      fprintf(stderr, "%-9s %9llu %7llu %14llu %14llu %10.1f\n", bench_names[op],
+        (unsigned long long)size, (unsigned long long)(count * batch),
+        (unsigned long long)median, (unsigned long long)p99, per);
+      fprintf(out, "%s\n  {\"op\": \"%s\", \"digits\": %llu, \"reps\": %llu, \"median_ns\": %llu, "
+        "\"p99_ns\": %llu, \"allocs_per_op\": %.2f}", (first) ? "" : ",", bench_names[op],
+        (unsigned long long)size, (unsigned long long)(count * batch),
+        (unsigned long long)median, (unsigned long long)p99, per);
+      fflush(out);
+      first = 0;
+      free(samples);
+    }
+    amhbi_free(5, a, b, wide, base, ten);
+    free(str);
+  }
+  fprintf(out, "\n]}\n");
+  if (json) fclose(out);
+  amhbi_rand_free(rand);
+  return 0;
+}
@@ -16,9 +16,12 @@ amhbi_init_zero ()
 amhbi_t *
 amhbi_init_cpy (amhbi_t *num)
 {
-  amhbi_t *cpy = amhbi_init_empty(amhbi_size(num));
+  // Copies share the digits; they are only duplicated before a write
+  amhbi_t *cpy = calloc(1, sizeof(amhbi_t));
+  assert(cpy);
+  cpy->digits = amhbi_share(num->digits);
   cpy->sign = amhbi_sign(num);
-  strncpy(cpy->digits, num->digits, amhbi_size(num));
+  cpy->length = amhbi_size(num);
   return cpy;
 }
 
@@ -26,6 +29,7 @@ amhbi_init_cpy (amhbi_t *num)
 amhbi_t *
 amhbi_init_str (char *str)
 {
+  AMHBI_SPAN(AMHBI_PROBE_INIT_STR, strlen(str));
   // Create bignum
   uint64_t length = strlen(str);
   amhbi_t *num = amhbi_init_empty(length);
@@ -46,6 +50,26 @@ amhbi_init_str (char *str)
 }
 
 
+amhbi_t *
+amhbi_set_str (amhbi_t *num, char *str)
+{
+  AMHBI_SPAN(AMHBI_PROBE_INIT_STR, strlen(str));
+  uint8_t sign = (str[0] == '-');
+  uint64_t length = strlen(&str[sign]);
+  
+  // Only a new buffer when the old one is shared or too short
+  amhbi_block_t *block = &((amhbi_block_t *)num->digits)[-1];
+  if (__atomic_load_n(&block->refs, __ATOMIC_ACQUIRE) != 1 || block->bytes < length + 1) {
+    amhbi_release(num->digits);
+    num->digits = amhbi_alloc(length + 1);
+  }
+  memcpy(num->digits, &str[sign], length + 1);
+  num->length = length;
+  num->sign = sign;
+  return amhbi_trim(num);
+}
+
+
 amhbi_t *
 amhbi_init_int (int64_t val)
 {
@@ -67,11 +91,11 @@ amhbi_init_uint (uint64_t val)
 static amhbi_t *
 amhbi_init_empty (uint64_t length)
 {
+  AMHBI_COUNT(AMHBI_PROBE_INIT_EMPTY, length);
   // Create struct and digit array
   amhbi_t *num = calloc(1, sizeof(amhbi_t));
   assert(num);
-  num->digits = calloc(length + 1, sizeof(char));
-  assert(num->digits);
+  num->digits = amhbi_alloc(length + 1);
   
   // Set initial parameters
   num->length = length;
@@ -80,9 +104,459 @@ amhbi_init_empty (uint64_t length)
 }
 
 
+/*
+ * Storage; large buffers can be backed by unlinked temporary files so that
+ * operands and transforms bigger than memory page to disk instead of failing
+ */
+
+static char *amhbi_tmpdir = NULL;
+static uint64_t amhbi_tmpdir_threshold = 0;
+static pthread_mutex_t amhbi_tmpdir_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+void
+amhbi_set_tmpdir (const char *dir, uint64_t threshold)
+{
+  char *copy = (dir) ? strdup(dir) : NULL;
+  pthread_mutex_lock(&amhbi_tmpdir_lock);
+  char *old = amhbi_tmpdir;
+  amhbi_tmpdir_threshold = threshold;
+  __atomic_store_n(&amhbi_tmpdir, copy, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&amhbi_tmpdir_lock);
+  free(old);
+}
+
+
+static char *
+amhbi_tmpdir_for (uint64_t bytes)
+{
+  // No directory is the usual case and takes no lock; otherwise a copy is
+  // made under the lock, since another thread may replace the directory
+  if (!__atomic_load_n(&amhbi_tmpdir, __ATOMIC_ACQUIRE)) return NULL;
+  pthread_mutex_lock(&amhbi_tmpdir_lock);
+  char *dir = NULL;
+  if (amhbi_tmpdir && bytes >= amhbi_tmpdir_threshold) dir = strdup(amhbi_tmpdir);
+  pthread_mutex_unlock(&amhbi_tmpdir_lock);
+  return dir;
+}
+
+
+/*
+ * Threads; kernels that split work between threads use at most this many,
+ * or one per online processor when it is zero. It may be changed while
+ * kernels run, which read it once as they start
+ */
+
+static uint64_t amhbi_threads = 0;
+
+
+void
+amhbi_set_threads (uint64_t n)
+{
+  __atomic_store_n(&amhbi_threads, n, __ATOMIC_RELAXED);
+}
+
+
+static uint64_t
+amhbi_get_threads ()
+{
+  uint64_t threads = __atomic_load_n(&amhbi_threads, __ATOMIC_RELAXED);
+  if (threads) return threads;
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? n : 1;
+}
+
+
+/*
+ * Instrumentation; each thread counts into its own block, found through a
+ * thread-local pointer, so probes take no locks. Blocks of exited threads
+ * are folded into the retired totals
+ */
+
+static uint8_t amhbi_instr_flags = 0;
+static amhbi_instr_thread_t *amhbi_instr_threads = NULL;
+static amhbi_instr_t amhbi_instr_retired;
+static amhbi_event_t *amhbi_instr_events = NULL;
+static uint64_t amhbi_instr_count_retired = 0;
+static pthread_mutex_t amhbi_instr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef AMHBI_INSTRUMENT
+static __thread amhbi_instr_thread_t *amhbi_instr_self = NULL;
+static uint64_t amhbi_instr_cap_retired = 0;
+static uint64_t amhbi_instr_tids = 0;
+static pthread_key_t amhbi_instr_key;
+static pthread_once_t amhbi_instr_once = PTHREAD_ONCE_INIT;
+#endif
+
+static const char *amhbi_instr_names[AMHBI_PROBES] = {
+  "add", "subt", "mult", "mult_long", "mult_dfft", "mult_ntt", "mult_ssa",
+  "mult_unbal", "mulmid", "div", "div_long", "div_newton", "recip", "root",
+  "gcd", "powm", "init_str", "to_str", "init_empty", "trim", "alloc"
+};
+
+
+void
+amhbi_instr_enable (uint8_t flags)
+{
+  __atomic_store_n(&amhbi_instr_flags, flags, __ATOMIC_RELAXED);
+}
+
+
+const char *
+amhbi_instr_name (amhbi_probe_t probe)
+{
+  return (probe < AMHBI_PROBES) ? amhbi_instr_names[probe] : "unknown";
+}
+
+
+static void
+amhbi_instr_merge (amhbi_instr_t *dst, amhbi_instr_t *src)
+{
+  // Depths are maxima, everything else sums
+  uint64_t p; for (p = 0; p < AMHBI_PROBES; p++) {
+    dst->calls[p] += __atomic_load_n(&src->calls[p], __ATOMIC_RELAXED);
+    dst->total[p] += __atomic_load_n(&src->total[p], __ATOMIC_RELAXED);
+    uint64_t depth = __atomic_load_n(&src->depth[p], __ATOMIC_RELAXED);
+    if (depth > dst->depth[p]) dst->depth[p] = depth;
+    uint64_t b; for (b = 0; b < AMHBI_INSTR_BUCKETS; b++) {
+      dst->sizes[p][b] += __atomic_load_n(&src->sizes[p][b], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+
+#ifdef AMHBI_INSTRUMENT
+
+static void
+amhbi_instr_key_init ()
+{
+  int ok = pthread_key_create(&amhbi_instr_key, amhbi_instr_retire);
+  assert(!ok);
+}
+
+
+static uint64_t
+amhbi_instr_now ()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+static amhbi_instr_thread_t *
+amhbi_instr_thread ()
+{
+  if (amhbi_instr_self) return amhbi_instr_self;
+  
+  // First probe on this thread; the key's destructor retires the block
+  pthread_once(&amhbi_instr_once, amhbi_instr_key_init);
+  amhbi_instr_thread_t *self = calloc(1, sizeof(amhbi_instr_thread_t));
+  assert(self);
+  pthread_setspecific(amhbi_instr_key, self);
+  
+  pthread_mutex_lock(&amhbi_instr_lock);
+  self->tid = ++amhbi_instr_tids;
+  self->next = amhbi_instr_threads;
+  if (amhbi_instr_threads) amhbi_instr_threads->prev = self;
+  amhbi_instr_threads = self;
+  pthread_mutex_unlock(&amhbi_instr_lock);
+  amhbi_instr_self = self;
+  return self;
+}
+
+
+static void
+amhbi_instr_retire (void *arg)
+{
+  amhbi_instr_thread_t *self = arg;
+  pthread_mutex_lock(&amhbi_instr_lock);
+  amhbi_instr_merge(&amhbi_instr_retired, &self->counts);
+  
+  // Keep the thread's spans for the trace
+  if (self->count) {
+    uint64_t need = amhbi_instr_count_retired + self->count;
+    if (need > amhbi_instr_cap_retired) {
+      amhbi_instr_cap_retired = (need > 2 * amhbi_instr_cap_retired) ? need : 2 * amhbi_instr_cap_retired;
+      amhbi_instr_events = realloc(amhbi_instr_events, amhbi_instr_cap_retired * sizeof(amhbi_event_t));
+      assert(amhbi_instr_events);
+    }
+    memcpy(&amhbi_instr_events[amhbi_instr_count_retired], self->events, self->count * sizeof(amhbi_event_t));
+    amhbi_instr_count_retired = need;
+  }
+  
+  // Unlink the block
+  if (self->prev) self->prev->next = self->next;
+  else amhbi_instr_threads = self->next;
+  if (self->next) self->next->prev = self->prev;
+  pthread_mutex_unlock(&amhbi_instr_lock);
+  free(self->events);
+  free(self);
+  amhbi_instr_self = NULL;
+}
+
+
+static void
+amhbi_instr_add (amhbi_instr_thread_t *self, amhbi_probe_t probe, uint64_t size)
+{
+  // Only this thread writes its block; stores are atomic so that snapshots
+  // from other threads read whole values
+  amhbi_instr_t *c = &self->counts;
+  uint64_t bucket = (size) ? 64 - __builtin_clzll(size) : 0;
+  if (bucket >= AMHBI_INSTR_BUCKETS) bucket = AMHBI_INSTR_BUCKETS - 1;
+  __atomic_store_n(&c->calls[probe], c->calls[probe] + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&c->total[probe], c->total[probe] + size, __ATOMIC_RELAXED);
+  __atomic_store_n(&c->sizes[probe][bucket], c->sizes[probe][bucket] + 1, __ATOMIC_RELAXED);
+}
+
+
+static void
+amhbi_instr_count (amhbi_probe_t probe, uint64_t size)
+{
+  if (!__atomic_load_n(&amhbi_instr_flags, __ATOMIC_RELAXED)) return;
+  amhbi_instr_add(amhbi_instr_thread(), probe, size);
+}
+
+
+static amhbi_span_t
+amhbi_instr_begin (amhbi_probe_t probe, uint64_t size)
+{
+  amhbi_span_t span = {probe, size, 0, 0};
+  uint8_t flags = __atomic_load_n(&amhbi_instr_flags, __ATOMIC_RELAXED);
+  if (!flags) return span;
+  
+  // Count the call and how deep it nests in calls of the same probe
+  amhbi_instr_thread_t *self = amhbi_instr_thread();
+  amhbi_instr_add(self, probe, size);
+  uint64_t depth = ++self->nesting[probe];
+  if (depth > self->counts.depth[probe]) {
+    __atomic_store_n(&self->counts.depth[probe], depth, __ATOMIC_RELAXED);
+  }
+  span.flags = flags;
+  if (flags & AMHBI_INSTR_TRACE) span.start = amhbi_instr_now();
+  return span;
+}
+
+
+static void
+amhbi_instr_end (amhbi_span_t *span)
+{
+  if (!span->flags) return;
+  amhbi_instr_thread_t *self = amhbi_instr_thread();
+  self->nesting[span->probe]--;
+  if (!(span->flags & AMHBI_INSTR_TRACE)) return;
+  
+  // Grow the buffer under the lock, since trace export may be reading it
+  uint64_t count = __atomic_load_n(&self->count, __ATOMIC_RELAXED);
+  if (count == self->cap) {
+    pthread_mutex_lock(&amhbi_instr_lock);
+    self->cap = (self->cap) ? 2 * self->cap : 1024;
+    self->events = realloc(self->events, self->cap * sizeof(amhbi_event_t));
+    assert(self->events);
+    pthread_mutex_unlock(&amhbi_instr_lock);
+  }
+  amhbi_event_t *event = &self->events[count];
+  event->probe = span->probe;
+  event->tid = self->tid;
+  event->start = span->start;
+  event->dur = amhbi_instr_now() - span->start;
+  event->size = span->size;
+  __atomic_store_n(&self->count, count + 1, __ATOMIC_RELEASE);
+}
+
+#endif
+
+
+void
+amhbi_instr_snapshot (amhbi_instr_t *out)
+{
+  memset(out, 0, sizeof(amhbi_instr_t));
+  pthread_mutex_lock(&amhbi_instr_lock);
+  amhbi_instr_merge(out, &amhbi_instr_retired);
+  amhbi_instr_thread_t *t; for (t = amhbi_instr_threads; t; t = t->next) {
+    amhbi_instr_merge(out, &t->counts);
+  }
+  pthread_mutex_unlock(&amhbi_instr_lock);
+}
+
+
+void
+amhbi_instr_reset ()
+{
+  // Counts made by other threads while this runs may survive it
+  pthread_mutex_lock(&amhbi_instr_lock);
+  memset(&amhbi_instr_retired, 0, sizeof(amhbi_instr_t));
+  amhbi_instr_count_retired = 0;
+  amhbi_instr_thread_t *t; for (t = amhbi_instr_threads; t; t = t->next) {
+    uint64_t *c = (uint64_t *)&t->counts;
+    uint64_t i; for (i = 0; i < sizeof(amhbi_instr_t) / sizeof(uint64_t); i++) {
+      __atomic_store_n(&c[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&t->count, 0, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&amhbi_instr_lock);
+}
+
+
+void
+amhbi_instr_print (FILE *file, amhbi_instr_t *out)
+{
+  fprintf(file, "%-11s %12s %14s %6s  %s\n", "probe", "calls", "mean size", "depth", "sizes (< 2^k: calls)");
+  uint64_t p; for (p = 0; p < AMHBI_PROBES; p++) {
+    if (!out->calls[p]) continue;
+    fprintf(file, "%-11s %12llu %14.1f %6llu ", amhbi_instr_names[p], (unsigned long long)out->calls[p],
+      (double)out->total[p] / out->calls[p], (unsigned long long)out->depth[p]);
+    uint64_t b; for (b = 0; b < AMHBI_INSTR_BUCKETS; b++) {
+      if (out->sizes[p][b]) fprintf(file, " %llu:%llu", (unsigned long long)b, (unsigned long long)out->sizes[p][b]);
+    }
+    fprintf(file, "\n");
+  }
+}
+
+
+static void
+amhbi_instr_write (FILE *file, amhbi_event_t *events, uint64_t count, uint8_t *first)
+{
+  int pid = getpid();
+  uint64_t i; for (i = 0; i < count; i++) {
+    amhbi_event_t *e = &events[i];
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"amhbi\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+      "\"pid\":%d,\"tid\":%llu,\"args\":{\"size\":%llu}}", (*first) ? "" : ",",
+      amhbi_instr_names[e->probe], e->start / 1000.0, e->dur / 1000.0, pid,
+      (unsigned long long)e->tid, (unsigned long long)e->size);
+    *first = 0;
+  }
+}
+
+
+void
+amhbi_instr_trace (FILE *file)
+{
+  uint8_t first = 1;
+  fprintf(file, "{\"traceEvents\":[");
+  pthread_mutex_lock(&amhbi_instr_lock);
+  amhbi_instr_write(file, amhbi_instr_events, amhbi_instr_count_retired, &first);
+  amhbi_instr_thread_t *t; for (t = amhbi_instr_threads; t; t = t->next) {
+    amhbi_instr_write(file, t->events, __atomic_load_n(&t->count, __ATOMIC_ACQUIRE), &first);
+  }
+  pthread_mutex_unlock(&amhbi_instr_lock);
+  fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+
+static void *
+amhbi_alloc (uint64_t bytes)
+{
+  AMHBI_COUNT(AMHBI_PROBE_ALLOC, bytes);
+  uint64_t total = sizeof(amhbi_block_t) + bytes;
+  amhbi_block_t *block;
+  
+  // Small buffers, or no directory configured; zeroed heap memory
+  char *dir = amhbi_tmpdir_for(bytes);
+  if (!dir) {
+    block = calloc(1, total);
+    assert(block);
+    block->bytes = bytes;
+    block->mapped = 0;
+    block->refs = 1;
+    return &block[1];
+  }
+  
+  // Large buffers map a sparse temporary file, which reads back as zeros;
+  // it is unlinked at once so nothing is left behind if the process dies
+  char path[strlen(dir) + 16];
+  sprintf(path, "%s/amhbi-XXXXXX", dir);
+  free(dir);
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+  int ok = ftruncate(fd, total);
+  assert(!ok);
+  block = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(block != MAP_FAILED);
+  close(fd);
+  madvise(block, total, MADV_SEQUENTIAL);
+  block->bytes = bytes;
+  block->mapped = 1;
+  block->refs = 1;
+  return &block[1];
+}
+
+
+static void *
+amhbi_realloc (void *ptr, uint64_t bytes)
+{
+  amhbi_block_t *block = &((amhbi_block_t *)ptr)[-1];
+  
+  // Heap buffers that stay below the threshold can grow in place
+  char *dir = (block->mapped) ? NULL : amhbi_tmpdir_for(bytes);
+  free(dir);
+  if (!block->mapped && !dir) {
+    block = realloc(block, sizeof(amhbi_block_t) + bytes);
+    assert(block);
+    block->bytes = bytes;
+    return &block[1];
+  }
+  
+  // Otherwise move to a new buffer of the right kind
+  void *res = amhbi_alloc(bytes);
+  memcpy(res, ptr, (block->bytes < bytes) ? block->bytes : bytes);
+  amhbi_dealloc(ptr);
+  return res;
+}
+
+
+static void
+amhbi_dealloc (void *ptr)
+{
+  amhbi_block_t *block = &((amhbi_block_t *)ptr)[-1];
+  if (block->mapped) {
+    munmap(block, sizeof(amhbi_block_t) + block->bytes);
+  } else {
+    free(block);
+  }
+}
+
+
+static char *
+amhbi_share (char *digits)
+{
+  amhbi_block_t *block = &((amhbi_block_t *)digits)[-1];
+  __atomic_add_fetch(&block->refs, 1, __ATOMIC_RELAXED);
+  return digits;
+}
+
+
+static void
+amhbi_release (char *digits)
+{
+  // The last owner to let go frees the buffer; the acquire makes every
+  // other owner's reads happen before that
+  amhbi_block_t *block = &((amhbi_block_t *)digits)[-1];
+  if (!__atomic_sub_fetch(&block->refs, 1, __ATOMIC_ACQ_REL)) {
+    amhbi_dealloc(digits);
+  }
+}
+
+
+static amhbi_t *
+amhbi_own (amhbi_t *num)
+{
+  // Writers get a private copy of digits that are shared
+  amhbi_block_t *block = &((amhbi_block_t *)num->digits)[-1];
+  if (__atomic_load_n(&block->refs, __ATOMIC_ACQUIRE) == 1) return num;
+  char *tmp = amhbi_alloc(amhbi_size(num) + 1);
+  memcpy(tmp, num->digits, amhbi_size(num));
+  amhbi_release(num->digits);
+  num->digits = tmp;
+  return num;
+}
+
+
 char * 
 amhbi_to_str (amhbi_t *num)
 {
+  AMHBI_SPAN(AMHBI_PROBE_TO_STR, amhbi_size(num));
   uint64_t length = amhbi_size(num);
   uint8_t offset = 0;
   char *str = calloc(length + 2, sizeof(char));
@@ -121,12 +595,12 @@ amhbi_trim (amhbi_t *num)
   
   // Stop here if there was no leading zeros
   if (!zeros) return num;
+  AMHBI_COUNT(AMHBI_PROBE_TRIM, amhbi_size(num));
   
   // Check if result will end up being zero
   if (!amhbi_size(num)) {
-    free(num->digits);
-    num->digits = calloc(2, sizeof(char));
-    assert(num->digits);
+    amhbi_release(num->digits);
+    num->digits = amhbi_alloc(2);
     num->digits[0] = '0';
     num->length = 1;
     num->sign = 0;
@@ -134,10 +608,9 @@ amhbi_trim (amhbi_t *num)
   }
   
   // Condense digit array and return the trimmed result
-  char *tmp = calloc(amhbi_size(num) + 1, sizeof(char));
-  assert(tmp);
-  strncpy(tmp, &num->digits[zeros], amhbi_size(num));
-  free(num->digits);
+  char *tmp = amhbi_alloc(amhbi_size(num) + 1);
+  memcpy(tmp, &num->digits[zeros], amhbi_size(num));
+  amhbi_release(num->digits);
   num->digits = tmp;
   return num;
 }
@@ -179,47 +652,26 @@ amhbi_split (amhbi_t *num, uint64_t i)
 }
 
 
-static int64_t *
+static uint64_t *
 amhbi_split_ntt (amhbi_t *num, uint64_t n)
 {
   // Create the result vector
-  int64_t *res = calloc(n, sizeof(int64_t));
-  assert(res);
+  uint64_t *res = amhbi_alloc(n * sizeof(uint64_t));
   
-  // Split the number into n parts, pad with zeros
-  amhbi_t *rem = amhbi_init_cpy(num);
+  // Read the digits into base 10^8 coefficients, least significant first
   uint64_t i; for (i = 0; i < n; i++) {
-    amhbi_t **split = amhbi_split(rem, amhbi_size(rem) - 1);
-    res[i] = amhbi_to_int(split[1]);
-    amhbi_free(2, rem, split[1]);
-    rem = split[0];
-    free(split);
+    if (i * AMHBI_NTT_DIGITS >= amhbi_size(num)) break;
+    uint64_t end = amhbi_size(num) - i * AMHBI_NTT_DIGITS;
+    uint64_t start = (end > AMHBI_NTT_DIGITS) ? end - AMHBI_NTT_DIGITS : 0;
+    uint64_t j; for (j = start; j < end; j++) {
+      res[i] = res[i] * 10 + (num->digits[j] - '0');
+    }
   }
   
   return res;
 }
 
 
-static amhbi_t *
-amhbi_concat (int argc, ...)
-{
-  assert(argc > 0);
-  va_list args;
-  va_start(args, argc);
-  amhbi_t *res = amhbi_init_cpy(va_arg(args, amhbi_t *));
-  int i; for (i = 1; i < argc; i++) {
-    amhbi_t *tmp = amhbi_init_cpy(va_arg(args, amhbi_t *));
-    char str[amhbi_size(res) + amhbi_size(tmp) + 1];
-    strncpy(str, res->digits, amhbi_size(res) + 1);
-    strncat(str, tmp->digits, amhbi_size(tmp) + 1);
-    amhbi_free(2, tmp, res);
-    res = amhbi_init_str(str);
-  }
-  va_end(args);
-  return res;
-}
-
-
 void
 amhbi_free (int argc, ...)
 {
@@ -228,7 +680,7 @@ amhbi_free (int argc, ...)
   va_start(args, argc);
   int i; for (i = 0; i < argc; i++) {
     amhbi_t *num = va_arg(args, amhbi_t *);
-    if (num && num->digits) free(num->digits);
+    if (num && num->digits) amhbi_release(num->digits);
     if (num) free(num);
   }
   va_end(args);
@@ -341,9 +793,8 @@ amhbi_abs (amhbi_t *num)
 amhbi_t *
 amhbi_negate (amhbi_t *num)
 {
-  if (amhbi_iszero(num)) return num;
   amhbi_t *cpy = amhbi_init_cpy(num);
-  cpy->sign = (amhbi_sign(num)) ? 0 : 1;
+  if (!amhbi_iszero(num)) cpy->sign = (amhbi_sign(num)) ? 0 : 1;
   return cpy;
 }
 
@@ -353,7 +804,7 @@ amhbi_decr (amhbi_t *num)
 {
   amhbi_t *decr = amhbi_init_str("1");
   amhbi_t *res = amhbi_subt(num, decr);
-  free(num->digits);
+  amhbi_release(num->digits);
   num->digits = res->digits;
   num->sign = res->sign;
   num->length = res->length;
@@ -367,7 +818,7 @@ amhbi_incr (amhbi_t *num)
 {
   amhbi_t *incr = amhbi_init_str("1");
   amhbi_t *res = amhbi_add(num, incr);
-  free(num->digits);
+  amhbi_release(num->digits);
   num->digits = res->digits;
   num->sign = res->sign;
   num->length = res->length;
@@ -382,18 +833,13 @@ amhbi_max (int argc, ...)
   assert(argc > 0);
   va_list args;
   va_start(args, argc);
-  amhbi_t *max = amhbi_init_cpy(va_arg(args, amhbi_t *));
+  amhbi_t *max = va_arg(args, amhbi_t *);
   int i; for (i = 1; i < argc; i++) {
-    amhbi_t *tmp = amhbi_init_cpy(va_arg(args, amhbi_t *));
-    if (amhbi_cmp(tmp, max) > 0) {
-      amhbi_free(1, max);
-      max = tmp;      
-    } else {
-      amhbi_free(1, tmp);
-    }
+    amhbi_t *tmp = va_arg(args, amhbi_t *);
+    if (amhbi_cmp(tmp, max) > 0) max = tmp;
   }
   va_end(args);
-  return max;
+  return amhbi_init_cpy(max);
 }
 
 
@@ -403,18 +849,13 @@ amhbi_min (int argc, ...)
   assert(argc > 0);
   va_list args;
   va_start(args, argc);
-  amhbi_t *min = amhbi_init_cpy(va_arg(args, amhbi_t *));
+  amhbi_t *min = va_arg(args, amhbi_t *);
   int i; for (i = 1; i < argc; i++) {
-    amhbi_t *tmp = amhbi_init_cpy(va_arg(args, amhbi_t *));
-    if (amhbi_cmp(tmp, min) < 0) {
-      amhbi_free(1, min);
-      min = tmp;
-    } else {
-      amhbi_free(1, tmp);
-    }
+    amhbi_t *tmp = va_arg(args, amhbi_t *);
+    if (amhbi_cmp(tmp, min) < 0) min = tmp;
   }
   va_end(args);
-  return min;
+  return amhbi_init_cpy(min);
 }
 
 
@@ -450,6 +891,7 @@ amhbi_cmp (amhbi_t *num1, amhbi_t *num2)
 amhbi_t *
 amhbi_add (amhbi_t *num1, amhbi_t *num2)
 {
+  AMHBI_SPAN(AMHBI_PROBE_ADD, amhbi_size(num1) + amhbi_size(num2));
   // Adjust operation based on the signs of the inputs
   uint8_t sign = 0;
   if (!amhbi_sign(num1) && amhbi_sign(num2)) {
@@ -462,7 +904,7 @@ amhbi_add (amhbi_t *num1, amhbi_t *num2)
     amhbi_t *res = amhbi_subt(num2, rev);
     amhbi_free(1, rev);
     return res;
-  } else if (amhbi_sign(num1) && amhbi_sign(num1)) {
+  } else if (amhbi_sign(num1) && amhbi_sign(num2)) {
     sign = 1;
     num1 = amhbi_negate(num1);
     num2 = amhbi_negate(num2);
@@ -518,14 +960,11 @@ amhbi_add_seq (int argc, ...)
   assert(argc > 0);
   va_list args;
   va_start(args, argc);
-  amhbi_t *sum = amhbi_init_cpy(va_arg(args, amhbi_t *));
-  int i; for (i = 1; i < argc; i++) {
-    amhbi_t *num = va_arg(args, amhbi_t *);
-    amhbi_t *tmp = amhbi_add(num, sum);
-    amhbi_free(1, sum);
-    sum = tmp;
-  }
+  amhbi_acc_t *acc = amhbi_acc_init();
+  int i; for (i = 0; i < argc; i++) amhbi_acc_add(acc, va_arg(args, amhbi_t *));
   va_end(args);
+  amhbi_t *sum = amhbi_acc_get(acc);
+  amhbi_acc_free(acc);
   return sum;
 }
 
@@ -533,6 +972,7 @@ amhbi_add_seq (int argc, ...)
 amhbi_t *
 amhbi_subt (amhbi_t *num1, amhbi_t *num2)
 {
+  AMHBI_SPAN(AMHBI_PROBE_SUBT, amhbi_size(num1) + amhbi_size(num2));
   // Adjust operation based on the signs of the inputs
   uint8_t sign = 0;
   if (amhbi_sign(num2)) {
@@ -606,14 +1046,12 @@ amhbi_subt_seq (int argc, ...)
   assert(argc > 0);
   va_list args;
   va_start(args, argc);
-  amhbi_t *diff = amhbi_init_cpy(va_arg(args, amhbi_t *));
-  int i; for (i = 1; i < argc; i++) {
-    amhbi_t *num = va_arg(args, amhbi_t *);
-    amhbi_t *tmp = amhbi_subt(diff, num);
-    amhbi_free(1, diff);
-    diff = tmp;
-  }
+  amhbi_acc_t *acc = amhbi_acc_init();
+  amhbi_acc_add(acc, va_arg(args, amhbi_t *));
+  int i; for (i = 1; i < argc; i++) amhbi_acc_sub(acc, va_arg(args, amhbi_t *));
   va_end(args);
+  amhbi_t *diff = amhbi_acc_get(acc);
+  amhbi_acc_free(acc);
   return diff;
 }
 
@@ -621,16 +1059,18 @@ amhbi_subt_seq (int argc, ...)
 amhbi_t *
 amhbi_mult (amhbi_t *num1, amhbi_t *num2)
 {
-  // For numbers smaller than 750 digits, use long multiplication
-  if (amhbi_size(num1) < 750 && amhbi_size(num2) < 750) {
+  AMHBI_SPAN(AMHBI_PROBE_MULT, amhbi_size(num1) + amhbi_size(num2));
+  // When either number is shorter than 100 digits, use long multiplication
+  if (amhbi_size(num1) < 100 || amhbi_size(num2) < 100) {
     return amhbi_mult_long(num1, num2);
   }
-  // For numbers smaller than 10000 digits, use the Karatsuba algorithm
-  //if (amhbi_size(num1) < 5000 && amhbi_size(num2) < 5000) {
-    return amhbi_mult_karatsuba(num1, num2);
-  //}
-  // For anything larger, use fast Fourier transforms
-  //return amhbi_mult_fft(num1, num2);
+  // Skewed products past the floating-point FFT are cheaper in slices
+  if ((amhbi_size(num1) >= AMHBI_UNBAL_RATIO * amhbi_size(num2) ||
+    amhbi_size(num2) >= AMHBI_UNBAL_RATIO * amhbi_size(num1)) &&
+    amhbi_size(num1) + amhbi_size(num2) >= AMHBI_DFFT_CUTOFF) {
+    return amhbi_mult_unbal(num1, num2);
+  }
+  return amhbi_mult_transform(num1, num2);
 }
 
 
@@ -655,440 +1095,4621 @@ amhbi_mult_seq (int argc, ...)
 amhbi_t *
 amhbi_mult_pow10 (amhbi_t *num, uint64_t p)
 {
-  assert(p >= 0);
-  if (!p) return amhbi_init_cpy(num);
+  if (!p || amhbi_iszero(num)) return amhbi_init_cpy(num);
   amhbi_t *cpy = amhbi_init_empty(amhbi_size(num) + p);
   cpy->sign = amhbi_sign(num);
-  strncpy(cpy->digits, num->digits, amhbi_size(num));
-  while (p) {
-    cpy->digits[amhbi_size(num) + p - 1] = '0';
-    p--;
-  }
-  return amhbi_trim(cpy);
+  memcpy(cpy->digits, num->digits, amhbi_size(num));
+  memset(&cpy->digits[amhbi_size(num)], '0', p);
+  return cpy;
 }
 
 
-static amhbi_t *
-amhbi_mult_long (amhbi_t *num1, amhbi_t *num2)
+amhbi_t *
+amhbi_mult_pow10_to (amhbi_t *num, uint64_t p)
 {
-  // Initialize result sum, set its sign
-  amhbi_t *sum = amhbi_init_zero();
-  
-  // Determine outer loop index, set inital power of ten to zero
-  uint64_t ind_2 = amhbi_size(num2);
-  uint64_t power = 0;
-  
-  // The outer loop is each digit of the multiplier
-  while (ind_2 > 0) {
-    amhbi_t *step = amhbi_init_empty(amhbi_size(num1) + 2);
-    uint64_t ind_s = amhbi_size(num1) + 2;
-    uint64_t ind_1 = amhbi_size(num1);
-    uint64_t mult = num2->digits[ind_2 - 1] - '0';
-    uint64_t carry = 0;
-    
-    // The inner loop is each digit of the multiplicand
-    while (ind_s > 0) {
-      // Calculate the product, add carry from previous iterations
-      uint64_t prod = 0;
-      if (ind_1 > 0) prod = ((num1->digits[ind_1 - 1] - '0') * mult);
-      prod += carry;
-      carry = 0;
-      
-      // Check for new carry
-      if (prod > 9) {carry = prod / 10; prod = prod % 10;} 
-      
-      // Set result and decrement inner indices
-      step->digits[ind_s - 1] = prod + '0';
-      if (ind_1) ind_1--;
-      if (ind_s) ind_s--;
-    }
-    
-    // Multiply this step by 10^power, add the result to the total sum
-    amhbi_t *tmp_step = amhbi_mult_pow10(step, power);
-    amhbi_t *tmp_sum = amhbi_add(sum, tmp_step);
-    amhbi_free(3, sum, step, tmp_step); sum = tmp_sum;
-    
-    if (ind_2) ind_2--;
-    power++;
-  }
-  
-  // Set sign and return
-  sum->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
-  return amhbi_trim(sum);
+  if (!p || amhbi_iszero(num)) return num;
+  amhbi_own(num);
+  char *tmp = amhbi_realloc(num->digits, amhbi_size(num) + p + 1);
+  memset(&tmp[amhbi_size(num)], '0', p);
+  tmp[amhbi_size(num) + p] = 0;
+  num->digits = tmp;
+  num->length += p;
+  return num;
 }
 
 
-static amhbi_t *
-amhbi_mult_karatsuba (amhbi_t *num1, amhbi_t *num2)
+amhbi_t *
+amhbi_divexact_pow10 (amhbi_t *num, uint64_t p)
 {
-  // Base case
-  if (amhbi_size(num1) == 1 || amhbi_size(num2) == 1) {
-    return amhbi_mult_long(num1, num2);
+  if (!p || amhbi_iszero(num)) return num;
+  assert(p < amhbi_size(num));
+  
+  // Dropping the trailing zeros only shortens the number; keep the buffer
+  uint64_t i; for (i = amhbi_size(num) - p; i < amhbi_size(num); i++) {
+    assert(num->digits[i] == '0');
   }
+  amhbi_own(num);
+  num->length -= p;
+  num->digits[amhbi_size(num)] = 0;
+  return num;
+}
 
-  // Figure out split size
-  uint64_t m = (amhbi_size_max(2, num1, num2) + 1) / 2;
-  uint64_t s1 = (amhbi_size(num1) > m) ? amhbi_size(num1) - m : 0;
-  uint64_t s2 = (amhbi_size(num2) > m) ? amhbi_size(num2) - m : 0;
-  
-  // Split each number
-  amhbi_t **split1 = amhbi_split(num1, s1);
-  amhbi_t **split2 = amhbi_split(num2, s2);
-  amhbi_t *h1 = split1[0];
-  amhbi_t *h2 = split2[0];
-  amhbi_t *l1 = split1[1];
-  amhbi_t *l2 = split2[1];
-  free(split1); free(split2);
-  
-  // Recurse on split numbers
-  amhbi_t *z2 = amhbi_mult(h1, h2);
-  amhbi_t *z0 = amhbi_mult(l1, l2);
-  amhbi_t *z1_0_0 = amhbi_add(h1, l1);
-  amhbi_t *z1_0_1 = amhbi_add(h2, l2);
-  amhbi_t *z1_0 = amhbi_mult(z1_0_0, z1_0_1);
-  amhbi_t *z1 = amhbi_subt_seq(3, z1_0, z2, z0);
-  
-  // Solve polynomial
-  amhbi_t *res2 = amhbi_mult_pow10(z2, m * 2);
-  amhbi_t *res1 = amhbi_mult_pow10(z1, m);
-  amhbi_t *res0 = amhbi_init_cpy(z0);
-  amhbi_t *res = amhbi_add_seq(3, res2, res1, res0);
-  
-  // Free intermediate results
-  amhbi_free(4, h1, h2, l1, l2);
-  amhbi_free(9, z2, z0, z1_0_0, z1_0_1, z1_0, z1, res2, res1, res0);
 
-  // Set sign and return
-  res->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1; 
+static amhbi_t *
+amhbi_slice (amhbi_t *num, uint64_t lo, uint64_t n)
+{
+  uint64_t size = amhbi_size(num);
+  if (lo >= size || !n) return amhbi_init_zero();
+  uint64_t len = (n > size - lo) ? size - lo : n;
+  amhbi_t *res = amhbi_init_empty(len);
+  memcpy(res->digits, &num->digits[size - lo - len], len);
   return amhbi_trim(res);
 }
 
 
-/*
- * TODO: Determine correct root of unity and modulus at runtime
- */
-
 static amhbi_t *
-amhbi_mult_fft (amhbi_t *num1, amhbi_t *num2)
+amhbi_mult_range (amhbi_t *num1, amhbi_t *num2, uint64_t lo, uint64_t hi)
 {
-  // Split numbers into zero padded vectors of size (n = 2^x) > s
-  uint64_t s = amhbi_size_max(2, num1, num2);
-  uint64_t n = pow(2, ceil(log((s + 1))/log(2)));
-  int64_t *one = amhbi_split_ntt(num1, n);
-  int64_t *two = amhbi_split_ntt(num2, n);
-
-  // Choose modulus and omega
-  long double w = 85;
-  int64_t m = 337;
-  
-  // Apply a NTT to each vector
-  int64_t *one_ntt = amhbi_fft(one, w, n, m);
-  int64_t *two_ntt = amhbi_fft(two, w, n, m);
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
   
-  // Pointwise multiplication (mod m)
-  int64_t *ires = calloc(n, sizeof(int64_t));
-  assert(ires);
-  uint64_t i; for (i = 0; i < n; i++) {
-    ires[i] = (one_ntt[i] * two_ntt[i]) % m;
+  // As in long multiplication, but only the columns in [lo, hi) are summed
+  uint64_t *cols = amhbi_alloc((hi - lo) * sizeof(uint64_t));
+  uint8_t *low2 = amhbi_alloc(size2);
+  uint64_t i; for (i = 0; i < size2; i++) {
+    low2[i] = num2->digits[size2 - i - 1] - '0';
+  }
+  for (i = 0; i < size1 && i < hi; i++) {
+    uint64_t mult = num1->digits[size1 - i - 1] - '0';
+    if (!mult) continue;
+    uint64_t j = (lo > i) ? lo - i : 0;
+    uint64_t end = (hi - i < size2) ? hi - i : size2;
+    for (; j < end; j++) {
+      cols[i + j - lo] += mult * low2[j];
+    }
   }
   
-  // Apply an inverse NTT to get the convolution
-  int64_t *res = amhbi_ifft(ires, w, n, m);
-  
-  // Restore the polynomial to integer form (x = base 10)
-  amhbi_t *sum = amhbi_init_int(res[0]);
-  for (i = 1; i < n; i++) {
-    amhbi_t *tmp1 = amhbi_init_int(res[i]);
-    amhbi_t *tmp2 = amhbi_mult_pow10(tmp1, i);
-    amhbi_t *tmp_sum = amhbi_add(tmp2, sum);
-    amhbi_free(3, sum, tmp1, tmp2);
-    sum = tmp_sum;
+  // A single carry pass writes the digits; the carry out of hi is dropped
+  amhbi_t *res = amhbi_init_empty(hi - lo);
+  uint64_t carry = 0;
+  for (i = 0; i < hi - lo; i++) {
+    carry += cols[i];
+    res->digits[hi - lo - i - 1] = (carry % 10) + '0';
+    carry /= 10;
   }
-
-  // Adjust sign and return
-  sum->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
-  return sum;
+  amhbi_dealloc(cols); amhbi_dealloc(low2);
+  return amhbi_trim(res);
 }
 
 
-static int64_t *
-amhbi_fft (int64_t *a, long double w, uint64_t n, uint64_t m)
+static amhbi_t *
+amhbi_mulmid_transform (amhbi_t *num1, amhbi_t *num2, uint64_t cut, uint64_t lo, uint64_t hi)
 {
-  // Base case
-  if (n == 1) return a;
-  
-  // Split vector a into even and odd halves
-  int64_t *a_even = calloc((n / 2), sizeof(int64_t));
-  int64_t *a_odd = calloc((n / 2), sizeof(int64_t));
-  uint64_t i = 0; uint64_t ev; for (ev = 0; ev < n; ev += 2) {
-    a_even[i++] = a[ev];
-  }
-  i = 0; uint64_t od; for (od = 1; od < n; od += 2) {
-    a_odd[i++] = a[od];
-  }  
-  
-  // Recurse on halves
-  int64_t *y_even = amhbi_fft(a_even, (w * w), (n / 2), m);
-  int64_t *y_odd = amhbi_fft(a_odd, (w * w), (n / 2), m);
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
   
-  // Initialize result vector
-  int64_t *y = calloc(n, sizeof(int64_t));
+  // Drop the digits that only reach columns below cut or from hi up
+  uint64_t d1 = (cut + 1 > size2) ? cut + 1 - size2 : 0;
+  uint64_t d2 = (cut + 1 > size1) ? cut + 1 - size1 : 0;
+  uint8_t dropped = (d1 || d2);
+  amhbi_t *one = amhbi_slice(num1, d1, hi - d1);
+  amhbi_t *two = amhbi_slice(num2, d2, hi - d2);
+  cut -= d1 + d2; lo -= d1 + d2; hi -= d1 + d2;
   
-  // Combine; x = w^i; apply modulus to result if requested
-  long double x = 1.0L;
-  for (i = 0; i < (n / 2); i++) {
-    y[i] = (y_even[i]) + (x * (y_odd[i]));
-    y[i+n/2] = (y_even[i]) - (x * (y_odd[i]));
-    // Mod the results
-    y[i] = (y[i] < 0) ? m - (abs(y[i]) % m) : y[i] % m;
-    y[i+n/2] = (y[i+n/2] < 0) ? m - (abs(y[i+n/2]) % m) : y[i+n/2] % m;
-    x *= w;
+  // Wanted columns stay clean in a cyclic product of length N >= hi as long
+  // as what wraps around, the product over 10^N, stays below 10^cut. That
+  // is the middle product; it pays once the product is past the
+  // floating-point FFT and N needs a shorter transform than the product
+  uint64_t total = amhbi_size(one) + amhbi_size(two);
+  uint64_t c1 = (amhbi_size(one) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (amhbi_size(two) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t need = (total - cut > hi) ? total - cut : hi;
+  uint64_t nf = 1, nw = 1;
+  while (nf < c1 + c2) nf <<= 1;
+  while (nw * AMHBI_NTT_DIGITS < need) nw <<= 1;
+  amhbi_t *res;
+  if (total >= AMHBI_DFFT_CUTOFF && nw < nf && nw <= (1ULL << AMHBI_NTT_MAXLOG)) {
+    amhbi_t *part = amhbi_mult_wrap(one, two, nw);
+    res = amhbi_mulmid_take(part, lo, hi - lo, dropped, cut);
+    amhbi_free(1, part);
+  } else {
+    amhbi_t *part = amhbi_mult(one, two);
+    res = amhbi_mulmid_take(part, lo, hi - lo, dropped, 0);
+    amhbi_free(1, part);
   }
-  
-  return y;
+  amhbi_free(2, one, two);
+  return res;
 }
 
 
-static int64_t *
-amhbi_ifft (int64_t *a, long double w, uint64_t n, uint64_t m)
+static amhbi_t *
+amhbi_mulmid_take (amhbi_t *part, uint64_t lo, uint64_t n, uint8_t dropped, uint64_t wrap)
 {
-  int64_t *res1 = amhbi_fft(a, w, n, m);
-  int64_t *res2 = calloc(n, sizeof(int64_t));
-  assert(res2);
-  int64_t r = amhbi_ifft_pow(n, (m - 2) % m, m) % m;
-  res2[0] = ((res1[0] % m) * (r % m)) % m;
-  uint8_t i; for (i = 1; i < n; i++) {
-    res2[i] = ((res1[n - i] % m) * (r % m)) % m;
+  // Dropped columns are worth less than 10^(lo - AMHBI_SHORT_GUARD), so
+  // they can only carry into the result past that many nines. A wrapped
+  // product also holds up to 10^wrap too much below lo, which borrows from
+  // the result unless the digits there are at least that
+  amhbi_t *low = amhbi_slice(part, 0, lo);
+  uint8_t clear = 1;
+  if (dropped && amhbi_size(low) == lo) {
+    uint64_t i;
+    for (i = 0; i < AMHBI_SHORT_GUARD && low->digits[i] == '9'; i++);
+    if (i == AMHBI_SHORT_GUARD) clear = 0;
   }
-  return res2;
+  if (wrap && (amhbi_iszero(low) || amhbi_size(low) <= wrap)) clear = 0;
+  amhbi_free(1, low);
+  return (clear) ? amhbi_slice(part, lo, n) : NULL;
 }
 
 
-static int64_t 
-amhbi_ifft_pow (uint64_t n, int64_t p, uint64_t m)
+static amhbi_t *
+amhbi_mult_long (amhbi_t *num1, amhbi_t *num2)
 {
-  int64_t res = 1;
-  uint64_t i; for (i = 0; i < p; i++) {
-    res = ((res % m) * (n % m)) % m;
+  AMHBI_SPAN(AMHBI_PROBE_MULT_LONG, amhbi_size(num1) + amhbi_size(num2));
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
+  
+  // Every digit product goes into its column, least significant first; a
+  // column never exceeds 81 * min(size1, size2), so carries can wait
+  uint64_t *cols = amhbi_alloc((size1 + size2) * sizeof(uint64_t));
+  uint8_t *low2 = amhbi_alloc(size2);
+  uint64_t i; for (i = 0; i < size2; i++) {
+    low2[i] = num2->digits[size2 - i - 1] - '0';
   }
-  return res;
-}
-
+  for (i = 0; i < size1; i++) {
+    uint64_t mult = num1->digits[size1 - i - 1] - '0';
+    if (!mult) continue;
+    uint64_t j; for (j = 0; j < size2; j++) {
+      cols[i + j] += mult * low2[j];
+    }
+  }
+  
+  // A single carry pass writes the digits
+  amhbi_t *prod = amhbi_init_empty(size1 + size2);
+  uint64_t carry = 0;
+  for (i = 0; i < size1 + size2; i++) {
+    carry += cols[i];
+    prod->digits[size1 + size2 - i - 1] = (carry % 10) + '0';
+    carry /= 10;
+  }
+  amhbi_dealloc(cols); amhbi_dealloc(low2);
+  
+  // Set sign and return
+  prod = amhbi_trim(prod);
+  if (!amhbi_iszero(prod)) {
+    prod->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+  }
+  return prod;
+}
+
+
+static amhbi_t *
+amhbi_mult_transform (amhbi_t *num1, amhbi_t *num2)
+{
+  // Floating-point FFTs are faster while their transforms stay in cache;
+  // they hand off to the NTT themselves if exactness cannot be proven
+  if (amhbi_size(num1) + amhbi_size(num2) < AMHBI_DFFT_CUTOFF) {
+    return amhbi_mult_dfft(num1, num2);
+  }
+  // Use number-theoretic transforms while the product fits the longest plan
+  uint64_t c1 = (amhbi_size(num1) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (amhbi_size(num2) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  if (c1 + c2 <= (1ULL << AMHBI_NTT_MAXLOG)) {
+    return amhbi_mult_fft(num1, num2);
+  }
+  // For anything larger, use Schonhage-Strassen
+  return amhbi_mult_ssa(num1, num2);
+}
+
+
+static amhbi_t *
+amhbi_mult_unbal (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_MULT_UNBAL, amhbi_size(num1) + amhbi_size(num2));
+  // Make num1 the longer operand
+  if (amhbi_size(num1) < amhbi_size(num2)) {
+    amhbi_t *tmp = num1; num1 = num2; num2 = tmp;
+  }
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
+  
+  // A short operand takes the longest slices that keep each product in the
+  // floating-point FFT
+  amhbi_t *small = amhbi_abs(num2);
+  amhbi_mulplan_t *plan = NULL;
+  uint64_t step = AMHBI_DFFT_CUTOFF - 1 - size2;
+  
+  // Otherwise the NTT spectrum of the short operand is kept and reused, so
+  // each slice costs two transforms instead of three. Pick the transform
+  // length n (slices of 8 * n - size2 digits) minimising the total, and
+  // only go ahead if that beats one transform of the whole product
+  if (2 * size2 >= AMHBI_DFFT_CUTOFF) {
+    uint64_t c1 = (size1 + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+    uint64_t c2 = (size2 + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+    double best = 0;
+    uint64_t lg = 0, n;
+    while ((1ULL << lg) < c1 + c2) lg++;
+    if (lg <= AMHBI_NTT_MAXLOG) best = 3.0 * (1ULL << lg) * lg;
+    step = 0;
+    for (lg = 0, n = 1; lg <= AMHBI_NTT_MAXLOG; lg++, n <<= 1) {
+      if (n < 2 * c2) continue;
+      uint64_t slices = (c1 + (n - c2) - 1) / (n - c2);
+      double cost = (1.0 + 2.0 * slices) * n * lg;
+      if (!best || cost < best) {
+        best = cost;
+        step = (n - c2) * AMHBI_NTT_DIGITS;
+      }
+    }
+    if (!step) {
+      amhbi_free(1, small);
+      return amhbi_mult_transform(num1, num2);
+    }
+    plan = amhbi_mulplan_init(small, step);
+  }
+  
+  // Multiply slices from the least significant end and add each product in
+  // at its offset; it only overlaps the previous one
+  amhbi_t *prod = amhbi_init_empty(size1 + size2);
+  memset(prod->digits, '0', size1 + size2);
+  uint64_t off; for (off = 0; off < size1; off += step) {
+    uint64_t len = (size1 - off < step) ? size1 - off : step;
+    amhbi_t *slice = amhbi_slice(num1, off, len);
+    amhbi_t *part;
+    if (plan) {
+      part = amhbi_mulplan_mult(plan, slice);
+    } else if (amhbi_size(slice) < 100) {
+      part = amhbi_mult_long(small, slice);
+    } else {
+      part = amhbi_mult_transform(small, slice);
+    }
+    
+    // Add the part's digits, then ripple the carry
+    char *dst = &prod->digits[size1 + size2 - off - 1];
+    char *src = &part->digits[amhbi_size(part) - 1];
+    uint8_t carry = 0;
+    uint64_t i; for (i = 0; i < amhbi_size(part); i++, dst--, src--) {
+      uint8_t sum = (*dst - '0') + (*src - '0') + carry;
+      carry = (sum >= 10);
+      *dst = (sum - ((carry) ? 10 : 0)) + '0';
+    }
+    for (; carry; dst--) {
+      carry = (*dst == '9');
+      *dst = (carry) ? '0' : *dst + 1;
+    }
+    amhbi_free(2, slice, part);
+  }
+  amhbi_mulplan_free(plan);
+  amhbi_free(1, small);
+  
+  // Set sign and return
+  prod = amhbi_trim(prod);
+  if (!amhbi_iszero(prod)) {
+    prod->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+  }
+  return prod;
+}
+
+
+/*
+ * NTT multiplication; three primes of the form c * 2^k + 1, all with
+ * primitive root 3, combined through the Chinese remainder theorem
+ */
+
+static const uint64_t amhbi_ntt_primes[AMHBI_NTT_PRIMES] = {
+  998244353, 167772161, 469762049
+};
+
+static amhbi_nttplan_t *amhbi_ntt_plans[AMHBI_NTT_PRIMES][AMHBI_NTT_MAXLOG + 1];
+static pthread_mutex_t amhbi_ntt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+void
+amhbi_ntt_prewarm (uint64_t n)
+{
+  uint64_t len; for (len = 1; len <= n && len <= (1ULL << AMHBI_NTT_MAXLOG); len <<= 1) {
+    uint8_t p; for (p = 0; p < AMHBI_NTT_PRIMES; p++) amhbi_ntt_plan(len, p);
+  }
+}
+
+
+static amhbi_nttplan_t *
+amhbi_ntt_plan (uint64_t n, uint8_t prime)
+{
+  uint64_t lg = 0;
+  while ((1ULL << lg) < n) lg++;
+  assert(lg <= AMHBI_NTT_MAXLOG && (1ULL << lg) == n);
+  
+  // Plans are immutable once published, so lookups need no lock
+  amhbi_nttplan_t *plan = __atomic_load_n(&amhbi_ntt_plans[prime][lg], __ATOMIC_ACQUIRE);
+  if (plan) return plan;
+  
+  pthread_mutex_lock(&amhbi_ntt_lock);
+  plan = amhbi_ntt_plans[prime][lg];
+  if (plan) {
+    pthread_mutex_unlock(&amhbi_ntt_lock);
+    return plan;
+  }
+  
+  // Create the plan and its tables
+  uint64_t m = amhbi_ntt_primes[prime];
+  plan = calloc(1, sizeof(amhbi_nttplan_t));
+  assert(plan);
+  plan->n = n;
+  plan->m = m;
+  plan->ninv = amhbi_powm_word(n % m, m - 2, m);
+  plan->roots = calloc(n, sizeof(uint64_t));
+  plan->iroots = calloc(n, sizeof(uint64_t));
+  assert(plan->roots && plan->iroots);
+  
+  // Twiddles; the stage of length len uses w_len^j, stored at [len / 2 + j]
+  uint64_t len; for (len = 2; len <= n; len <<= 1) {
+    uint64_t half = len / 2;
+    uint64_t w = amhbi_powm_word(3, (m - 1) / len, m);
+    uint64_t iw = amhbi_powm_word(w, m - 2, m);
+    plan->roots[half] = 1;
+    plan->iroots[half] = 1;
+    uint64_t j; for (j = 1; j < half; j++) {
+      plan->roots[half + j] = (plan->roots[half + j - 1] * w) % m;
+      plan->iroots[half + j] = (plan->iroots[half + j - 1] * iw) % m;
+    }
+  }
+  
+  __atomic_store_n(&amhbi_ntt_plans[prime][lg], plan, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&amhbi_ntt_lock);
+  return plan;
+}
+
+
+static void
+amhbi_ntt (uint64_t *a, amhbi_nttplan_t *plan, uint8_t inverse)
+{
+  uint64_t n = plan->n;
+  uint64_t block = AMHBI_FFT_BLOCK / sizeof(uint64_t);
+  if (block > n) block = n;
+  uint64_t lo, len;
+  
+  // The forward transform is decimation in frequency, natural order in and
+  // bit reversed order out; the inverse is decimation in time, taking bit
+  // reversed order back to natural. Pointwise products do not care about the
+  // order in between, so no permutation pass is ever made. Levels no longer
+  // than a block are all done on one block before moving to the next, so
+  // only the longer ones sweep the whole array, front to back, which suits
+  // buffers paged from disk
+  if (!inverse) {
+    for (len = n; len > block; len >>= 1) amhbi_ntt_pass(a, plan, len, 0, n, 0);
+    for (lo = 0; lo < n; lo += block) {
+      for (len = block; len >= 2; len >>= 1) amhbi_ntt_pass(a, plan, len, lo, lo + block, 0);
+    }
+    return;
+  }
+  
+  // The scaling by n^-1 comes first, while each block is visited anyway
+  for (lo = 0; lo < n; lo += block) {
+    uint64_t i; for (i = lo; i < lo + block; i++) a[i] = (a[i] * plan->ninv) % plan->m;
+    for (len = 2; len <= block; len <<= 1) amhbi_ntt_pass(a, plan, len, lo, lo + block, 1);
+  }
+  for (len = 2 * block; len <= n; len <<= 1) amhbi_ntt_pass(a, plan, len, 0, n, 1);
+}
+
+
+static void
+amhbi_ntt_pass (uint64_t *a, amhbi_nttplan_t *plan, uint64_t len, uint64_t lo, uint64_t hi, uint8_t inverse)
+{
+  uint64_t m = plan->m;
+  uint64_t half = len / 2;
+  uint64_t i; for (i = lo; i < hi; i += len) {
+    uint64_t j; for (j = 0; j < half; j++) {
+      uint64_t u = a[i + j];
+      if (!inverse) {
+        uint64_t v = a[i + j + half];
+        a[i + j] = (u + v >= m) ? u + v - m : u + v;
+        a[i + j + half] = (((u >= v) ? u - v : u + m - v) * plan->roots[half + j]) % m;
+      } else {
+        uint64_t v = (a[i + j + half] * plan->iroots[half + j]) % m;
+        a[i + j] = (u + v >= m) ? u + v - m : u + v;
+        a[i + j + half] = (u >= v) ? u - v : u + m - v;
+      }
+    }
+  }
+}
+
+
+static amhbi_t *
+amhbi_mult_fft (amhbi_t *num1, amhbi_t *num2)
+{
+  // A cyclic convolution of length (n = 2^x) >= the product never wraps
+  uint64_t c1 = (amhbi_size(num1) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (amhbi_size(num2) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t n = 1;
+  while (n < c1 + c2) n <<= 1;
+  amhbi_t *prod = amhbi_mult_wrap(num1, num2, n);
+  
+  // Adjust sign and return
+  if (!amhbi_iszero(prod)) {
+    prod->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+  }
+  return prod;
+}
+
+
+static amhbi_t *
+amhbi_mult_wrap (amhbi_t *num1, amhbi_t *num2, uint64_t n)
+{
+  AMHBI_SPAN(AMHBI_PROBE_MULT_NTT, n * AMHBI_NTT_DIGITS);
+  assert(amhbi_size(num1) <= n * AMHBI_NTT_DIGITS);
+  assert(amhbi_size(num2) <= n * AMHBI_NTT_DIGITS);
+  uint64_t *one = amhbi_split_ntt(num1, n);
+  uint64_t *two = amhbi_split_ntt(num2, n);
+  
+  // Convolve modulo each prime
+  uint64_t *res[AMHBI_NTT_PRIMES];
+  uint64_t *tmp = amhbi_alloc(n * sizeof(uint64_t));
+  uint8_t p; for (p = 0; p < AMHBI_NTT_PRIMES; p++) {
+    amhbi_nttplan_t *plan = amhbi_ntt_plan(n, p);
+    res[p] = amhbi_alloc(n * sizeof(uint64_t));
+    memcpy(res[p], one, n * sizeof(uint64_t));
+    memcpy(tmp, two, n * sizeof(uint64_t));
+    amhbi_ntt(res[p], plan, 0);
+    amhbi_ntt(tmp, plan, 0);
+    uint64_t i; for (i = 0; i < n; i++) {
+      res[p][i] = (res[p][i] * tmp[i]) % plan->m;
+    }
+    amhbi_ntt(res[p], plan, 1);
+  }
+  amhbi_dealloc(one); amhbi_dealloc(two); amhbi_dealloc(tmp);
+  
+  // Recover the product from its residues; since 10^8n = 1 modulo 10^8n - 1,
+  // the carry out of the top coefficient comes back in at the bottom
+  uint64_t carry;
+  amhbi_t *prod = amhbi_ntt_combine(res, n, &carry);
+  for (p = 0; p < AMHBI_NTT_PRIMES; p++) amhbi_dealloc(res[p]);
+  if (carry) {
+    amhbi_t *wrap = amhbi_init_uint(carry);
+    amhbi_t *tmp = amhbi_add(prod, wrap);
+    amhbi_free(2, prod, wrap);
+    prod = tmp;
+  }
+  
+  // At most one reduction brings the sum back below 10^8n - 1
+  amhbi_t *mod = amhbi_init_empty(n * AMHBI_NTT_DIGITS);
+  memset(mod->digits, '9', n * AMHBI_NTT_DIGITS);
+  if (amhbi_cmp(prod, mod) >= 0) {
+    amhbi_t *tmp = amhbi_subt(prod, mod);
+    amhbi_free(1, prod);
+    prod = tmp;
+  }
+  amhbi_free(1, mod);
+  return prod;
+}
+
+
+static amhbi_t *
+amhbi_ntt_combine (uint64_t **res, uint64_t n, uint64_t *wrap)
+{
+  // Garner's algorithm recovers each coefficient, then carry in base 10^8
+  uint64_t m1 = amhbi_ntt_primes[0];
+  uint64_t m2 = amhbi_ntt_primes[1];
+  uint64_t m3 = amhbi_ntt_primes[2];
+  uint64_t inv12 = amhbi_powm_word(m1 % m2, m2 - 2, m2);
+  uint64_t inv123 = amhbi_powm_word((m1 * m2) % m3, m3 - 2, m3);
+  amhbi_t *prod = amhbi_init_empty(n * AMHBI_NTT_DIGITS);
+  unsigned __int128 carry = 0;
+  uint64_t i; for (i = 0; i < n; i++) {
+    uint64_t x2 = ((res[1][i] + m2 - res[0][i] % m2) % m2 * inv12) % m2;
+    uint64_t x12 = res[0][i] + m1 * x2;
+    uint64_t x3 = ((res[2][i] + m3 - x12 % m3) % m3 * inv123) % m3;
+    carry += (unsigned __int128)x12 + (unsigned __int128)(m1 * m2) * x3;
+    uint64_t coef = (uint64_t)(carry % AMHBI_NTT_BASE);
+    carry /= AMHBI_NTT_BASE;
+    uint64_t d; for (d = 0; d < AMHBI_NTT_DIGITS; d++) {
+      prod->digits[(n - i) * AMHBI_NTT_DIGITS - d - 1] = (coef % 10) + '0';
+      coef /= 10;
+    }
+  }
+  if (wrap) {
+    *wrap = (uint64_t)carry;
+  } else {
+    assert(!carry);
+  }
+  return amhbi_trim(prod);
+}
+
+
+/*
+ * Floating-point FFT multiplication; complex double transforms of small
+ * decimal pieces, used only while Percival's error bound proves that
+ * rounding the result recovers the exact convolution
+ */
+
+static amhbi_dfftplan_t *amhbi_dfft_plans[AMHBI_DFFT_MAXLOG + 1];
+static pthread_mutex_t amhbi_dfft_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static amhbi_dfftplan_t *
+amhbi_dfft_plan (uint64_t lg)
+{
+  assert(lg <= AMHBI_DFFT_MAXLOG);
+  
+  // Plans are immutable once published, so lookups need no lock
+  amhbi_dfftplan_t *plan = __atomic_load_n(&amhbi_dfft_plans[lg], __ATOMIC_ACQUIRE);
+  if (plan) return plan;
+  
+  pthread_mutex_lock(&amhbi_dfft_lock);
+  plan = amhbi_dfft_plans[lg];
+  if (plan) {
+    pthread_mutex_unlock(&amhbi_dfft_lock);
+    return plan;
+  }
+  
+  // Create the plan; each twiddle is computed directly, never by recurrence,
+  // so every one of them is within an ulp or so of exp(-2 pi i k / n)
+  uint64_t n = 1ULL << lg;
+  plan = calloc(1, sizeof(amhbi_dfftplan_t));
+  assert(plan);
+  plan->n = n;
+  plan->rev = calloc(n, sizeof(uint32_t));
+  plan->wr = calloc(n / 2 + 1, sizeof(double));
+  plan->wi = calloc(n / 2 + 1, sizeof(double));
+  assert(plan->rev && plan->wr && plan->wi);
+  uint64_t i; for (i = 1; i < n; i++) {
+    plan->rev[i] = (plan->rev[i >> 1] >> 1) | ((i & 1) ? (n >> 1) : 0);
+  }
+  for (i = 0; i < n / 2 + 1; i++) {
+    long double t = -2.0L * 3.14159265358979323846264338327950288L * i / n;
+    plan->wr[i] = (double)cosl(t);
+    plan->wi[i] = (double)sinl(t);
+  }
+  
+  __atomic_store_n(&amhbi_dfft_plans[lg], plan, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&amhbi_dfft_lock);
+  return plan;
+}
+
+
+static void
+amhbi_dfft (double *re, double *im, amhbi_dfftplan_t *plan)
+{
+  uint64_t n = plan->n;
+  
+  // Permute into bit reversed order
+  uint64_t i; for (i = 0; i < n; i++) {
+    uint64_t j = plan->rev[i];
+    if (i < j) {
+      double tr = re[i]; re[i] = re[j]; re[j] = tr;
+      double ti = im[i]; im[i] = im[j]; im[j] = ti;
+    }
+  }
+  
+  // An odd number of levels starts with one radix-2 pass; twiddles are 1
+  uint64_t lg = 0;
+  while ((1ULL << lg) < n) lg++;
+  uint64_t len = 2;
+  if (lg % 2) {
+    for (i = 0; i < n; i += 2) {
+      double ur = re[i], ui = im[i];
+      double vr = re[i + 1], vi = im[i + 1];
+      re[i] = ur + vr; im[i] = ui + vi;
+      re[i + 1] = ur - vr; im[i + 1] = ui - vi;
+    }
+    len = 4;
+  }
+  
+  // Radix-4 passes; each one fuses the levels of length len and 2 * len, so
+  // the arithmetic and its rounding match two radix-2 levels exactly. The
+  // first pass of an even number of levels has only unit twiddles
+  if (len == 2 && 2 * len <= n) {
+    for (i = 0; i < n; i += 4) {
+      double a0r = re[i] + re[i + 1], a0i = im[i] + im[i + 1];
+      double a1r = re[i] - re[i + 1], a1i = im[i] - im[i + 1];
+      double a2r = re[i + 2] + re[i + 3], a2i = im[i + 2] + im[i + 3];
+      double a3r = re[i + 2] - re[i + 3], a3i = im[i + 2] - im[i + 3];
+      re[i] = a0r + a2r; im[i] = a0i + a2i;
+      re[i + 2] = a0r - a2r; im[i + 2] = a0i - a2i;
+      re[i + 1] = a1r + a3i; im[i + 1] = a1i - a3r;
+      re[i + 3] = a1r - a3i; im[i + 3] = a1i + a3r;
+    }
+    len = 8;
+  }
+  
+  // Later passes run two neighbouring butterflies per step in vector
+  // registers; every lane does the same operations as the scalar code
+  for (; 2 * len <= n; len *= 4) {
+    uint64_t h = len / 2;
+    uint64_t s1 = n / len;
+    uint64_t s2 = n / (2 * len);
+    for (i = 0; i < n; i += 2 * len) {
+      uint64_t j; for (j = 0; j < h; j += 2) {
+        amhbi_v2d_t w1r = {plan->wr[j * s1], plan->wr[(j + 1) * s1]};
+        amhbi_v2d_t w1i = {plan->wi[j * s1], plan->wi[(j + 1) * s1]};
+        amhbi_v2d_t w2r = {plan->wr[j * s2], plan->wr[(j + 1) * s2]};
+        amhbi_v2d_t w2i = {plan->wi[j * s2], plan->wi[(j + 1) * s2]};
+        uint64_t x0 = i + j, x1 = x0 + h, x2 = x0 + len, x3 = x2 + h;
+        amhbi_v2d_t r0, i0, r1, i1, r2, i2, r3, i3;
+        memcpy(&r0, &re[x0], sizeof(r0)); memcpy(&i0, &im[x0], sizeof(i0));
+        memcpy(&r1, &re[x1], sizeof(r1)); memcpy(&i1, &im[x1], sizeof(i1));
+        memcpy(&r2, &re[x2], sizeof(r2)); memcpy(&i2, &im[x2], sizeof(i2));
+        memcpy(&r3, &re[x3], sizeof(r3)); memcpy(&i3, &im[x3], sizeof(i3));
+        
+        // First level: (x0, x1) and (x2, x3), both with w1
+        amhbi_v2d_t tr = r1 * w1r - i1 * w1i;
+        amhbi_v2d_t ti = r1 * w1i + i1 * w1r;
+        amhbi_v2d_t a0r = r0 + tr, a0i = i0 + ti;
+        amhbi_v2d_t a1r = r0 - tr, a1i = i0 - ti;
+        tr = r3 * w1r - i3 * w1i;
+        ti = r3 * w1i + i3 * w1r;
+        amhbi_v2d_t a2r = r2 + tr, a2i = i2 + ti;
+        amhbi_v2d_t a3r = r2 - tr, a3i = i2 - ti;
+        
+        // Second level: (x0, x2) with w2, (x1, x3) with w2 * -i
+        tr = a2r * w2r - a2i * w2i;
+        ti = a2r * w2i + a2i * w2r;
+        r0 = a0r + tr; i0 = a0i + ti;
+        r2 = a0r - tr; i2 = a0i - ti;
+        tr = a3r * w2i + a3i * w2r;
+        ti = -(a3r * w2r - a3i * w2i);
+        r1 = a1r + tr; i1 = a1i + ti;
+        r3 = a1r - tr; i3 = a1i - ti;
+        memcpy(&re[x0], &r0, sizeof(r0)); memcpy(&im[x0], &i0, sizeof(i0));
+        memcpy(&re[x1], &r1, sizeof(r1)); memcpy(&im[x1], &i1, sizeof(i1));
+        memcpy(&re[x2], &r2, sizeof(r2)); memcpy(&im[x2], &i2, sizeof(i2));
+        memcpy(&re[x3], &r3, sizeof(r3)); memcpy(&im[x3], &i3, sizeof(i3));
+      }
+    }
+  }
+}
+
+
+static amhbi_t *
+amhbi_mult_dfft (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_MULT_DFFT, amhbi_size(num1) + amhbi_size(num2));
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
+  
+  // Try the widest pieces first, narrowing them until the bound holds
+  uint64_t k; for (k = 4; k >= 2; k--) {
+    uint64_t base = (k == 4) ? 10000 : (k == 3) ? 1000 : 100;
+    uint64_t c1 = (size1 + k - 1) / k;
+    uint64_t c2 = (size2 + k - 1) / k;
+    uint64_t lg = 0;
+    while ((1ULL << lg) < c1 + c2) lg++;
+    if (lg > AMHBI_DFFT_MAXLOG) break;
+    uint64_t n = 1ULL << lg;
+    
+    // Pack num1 into the real part and num2 into the imaginary part
+    double *re = calloc(n, sizeof(double));
+    double *im = calloc(n, sizeof(double));
+    assert(re && im);
+    double norm = 0;
+    uint64_t i; for (i = 0; i < c1 + c2; i++) {
+      amhbi_t *num = (i < c1) ? num1 : num2;
+      uint64_t piece = (i < c1) ? i : i - c1;
+      uint64_t end = amhbi_size(num) - piece * k;
+      uint64_t start = (end > k) ? end - k : 0;
+      uint64_t val = 0;
+      uint64_t j; for (j = start; j < end; j++) val = val * 10 + (num->digits[j] - '0');
+      if (i < c1) re[piece] = val; else im[piece] = val;
+      norm += (double)val * val;
+    }
+    
+    // Percival's bound on the error of a convolution through a length 2^lg
+    // transform: |x| |y| ((1 + e)^3lg (1 + e sqrt5)^(3lg + 1) (1 + b)^3lg - 1);
+    // here x = y = num1 + i num2, and the twiddles are within b = 2e
+    double e = ldexp(1.0, -53);
+    double growth = expm1(3 * lg * log1p(e) + (3 * lg + 1) * log1p(e * sqrt(5.0)) +
+      3 * lg * log1p(2 * e));
+    double bound = norm * growth * (1 + ldexp(1.0, -40));
+    if (bound >= 0.5) {
+      free(re); free(im);
+      continue;
+    }
+    
+    // (num1 + i num2)^2 = num1^2 - num2^2 + 2i num1 num2, so the product is
+    // half the imaginary part; the inverse is the conjugated forward transform
+    amhbi_dfftplan_t *plan = amhbi_dfft_plan(lg);
+    amhbi_dfft(re, im, plan);
+    for (i = 0; i < n; i++) {
+      double r = re[i] * re[i] - im[i] * im[i];
+      double t = 2 * re[i] * im[i];
+      re[i] = r;
+      im[i] = -t;
+    }
+    amhbi_dfft(re, im, plan);
+    
+    // Round each coefficient, then carry into the digits
+    amhbi_t *prod = amhbi_init_empty(n * k);
+    uint64_t carry = 0;
+    for (i = 0; i < n; i++) {
+      carry += (uint64_t)llround(-im[i] / (2.0 * n));
+      uint64_t coef = carry % base;
+      carry /= base;
+      uint64_t d; for (d = 0; d < k; d++) {
+        prod->digits[(n - i) * k - d - 1] = (coef % 10) + '0';
+        coef /= 10;
+      }
+    }
+    assert(!carry);
+    free(re); free(im);
+    
+    // Adjust sign and return
+    prod = amhbi_trim(prod);
+    if (!amhbi_iszero(prod)) {
+      prod->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+    }
+    return prod;
+  }
+  
+  // The bound could not be met; the NTT is exact at any size
+  return amhbi_mult_fft(num1, num2);
+}
+
+
+/*
+ * Schonhage-Strassen multiplication over Z / (10^N + 1); 10 is a root of
+ * unity of order 2N there, so every twiddle is a (negacyclic) shift of whole
+ * base 10^8 limbs. Elements hold L + 1 limbs, the last one only set for 10^N
+ */
+
+static amhbi_t *
+amhbi_mult_ssa (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_MULT_SSA, amhbi_size(num1) + amhbi_size(num2));
+  uint64_t c1 = (amhbi_size(num1) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  uint64_t c2 = (amhbi_size(num2) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  
+  // Pick the transform length by a cost model rather than a fixed ratio, so
+  // cost moves smoothly with size; pieces of m limbs must not wrap around
+  // (p1 + p2 - 1 <= K), and an element must hold K times a coefficient
+  // exactly (N >= 2 * 8m + 2 * digits(K) + 1) with L a multiple of K / 2
+  uint64_t K = 0, m = 0, L = 0;
+  double best = 0;
+  uint64_t k; for (k = 1; k <= AMHBI_SSA_MAXLOG; k++) {
+    uint64_t kk = 1ULL << k;
+    uint64_t km = (c1 + c2 + kk - 2) / (kk - 1);
+    uint64_t kdig = 1;
+    uint64_t t; for (t = kk; t >= 10; t /= 10) kdig++;
+    uint64_t kl = 2 * km + (2 * kdig + AMHBI_SSA_DIGITS) / AMHBI_SSA_DIGITS;
+    kl = (kl + kk / 2 - 1) / (kk / 2) * (kk / 2);
+    double n = (double)kl * AMHBI_SSA_DIGITS;
+    double cost = kk * (n * log2(n) + 4.0 * k * kl);
+    if (!K || cost < best) {
+      best = cost; K = kk; m = km; L = kl;
+    }
+  }
+  
+  // Split both numbers into K elements of m limbs each; squares share them
+  uint8_t square = (num1 == num2) ? 1 : 0;
+  uint32_t *one = amhbi_alloc(K * (L + 1) * sizeof(uint32_t));
+  uint32_t *two = (square) ? one : amhbi_alloc(K * (L + 1) * sizeof(uint32_t));
+  uint32_t **a = calloc(K, sizeof(uint32_t *));
+  uint32_t **b = (square) ? a : calloc(K, sizeof(uint32_t *));
+  uint32_t *tmp = calloc(2 * (L + 1), sizeof(uint32_t));
+  assert(one && two && a && b && tmp);
+  uint64_t i; for (i = 0; i < K; i++) {
+    a[i] = &one[i * (L + 1)];
+    b[i] = &two[i * (L + 1)];
+  }
+  for (i = 0; i < c1; i++) a[i / m][i % m] = amhbi_ssa_limb(num1, i);
+  if (!square) {
+    for (i = 0; i < c2; i++) b[i / m][i % m] = amhbi_ssa_limb(num2, i);
+  }
+  
+  // Forward transforms, pointwise products, inverse transform
+  amhbi_ssa_fft(a, K, L, 0, tmp);
+  if (!square) amhbi_ssa_fft(b, K, L, 0, tmp);
+  for (i = 0; i < K; i++) amhbi_ssa_mulmod(a[i], a[i], b[i], L);
+  amhbi_ssa_fft(a, K, L, 1, tmp);
+  
+  // Each element is now K times a coefficient, exactly; divide it out and
+  // add the coefficients at their offsets, deferring the carries
+  uint64_t size = c1 + c2 + L + 1;
+  uint64_t *acc = amhbi_alloc(size * sizeof(uint64_t));
+  for (i = 0; i < K; i++) {
+    uint64_t rem = 0;
+    uint64_t j; for (j = L + 1; j > 0; j--) {
+      uint64_t cur = rem * AMHBI_SSA_BASE + a[i][j - 1];
+      a[i][j - 1] = cur / K;
+      rem = cur % K;
+    }
+    assert(!rem);
+    for (j = 0; j <= L && i * m + j < size; j++) acc[i * m + j] += a[i][j];
+  }
+  free(a); free(tmp); amhbi_dealloc(one);
+  if (!square) {
+    free(b); amhbi_dealloc(two);
+  }
+  
+  // A single carry pass writes the digits
+  amhbi_t *prod = amhbi_init_empty(size * AMHBI_SSA_DIGITS);
+  uint64_t carry = 0;
+  for (i = 0; i < size; i++) {
+    carry += acc[i];
+    uint64_t limb = carry % AMHBI_SSA_BASE;
+    carry /= AMHBI_SSA_BASE;
+    uint64_t d; for (d = 0; d < AMHBI_SSA_DIGITS; d++) {
+      prod->digits[(size - i) * AMHBI_SSA_DIGITS - d - 1] = (limb % 10) + '0';
+      limb /= 10;
+    }
+  }
+  assert(!carry);
+  amhbi_dealloc(acc);
+  
+  // Adjust sign and return
+  prod = amhbi_trim(prod);
+  if (!amhbi_iszero(prod)) {
+    prod->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+  }
+  return prod;
+}
+
+
+static uint32_t
+amhbi_ssa_limb (amhbi_t *num, uint64_t i)
+{
+  // Limb i counts base 10^8 limbs up from the least significant digit
+  uint64_t end = amhbi_size(num) - i * AMHBI_SSA_DIGITS;
+  uint64_t start = (end > AMHBI_SSA_DIGITS) ? end - AMHBI_SSA_DIGITS : 0;
+  uint32_t limb = 0;
+  uint64_t j; for (j = start; j < end; j++) limb = limb * 10 + (num->digits[j] - '0');
+  return limb;
+}
+
+
+static void
+amhbi_ssa_add (uint32_t *r, uint32_t *a, uint32_t *b, uint64_t L)
+{
+  uint32_t carry = 0;
+  uint64_t i; for (i = 0; i <= L; i++) {
+    uint32_t sum = a[i] + b[i] + carry;
+    carry = (sum >= AMHBI_SSA_BASE) ? 1 : 0;
+    r[i] = (carry) ? sum - AMHBI_SSA_BASE : sum;
+  }
+  
+  // The sum is at most 2 * 10^N; fold the top limb back since 10^N = -1
+  uint32_t t = r[L];
+  if (!t) return;
+  r[L] = 0;
+  uint8_t low = (r[0] >= t) ? 1 : 0;
+  for (i = 1; i < L && !low; i++) {
+    if (r[i]) low = 1;
+  }
+  if (low) {
+    uint32_t borrow = t;
+    for (i = 0; borrow; i++) {
+      if (r[i] >= borrow) {
+        r[i] -= borrow;
+        borrow = 0;
+      } else {
+        r[i] = r[i] + AMHBI_SSA_BASE - borrow;
+        borrow = 1;
+      }
+    }
+  } else if (r[0] + 1 == t) {
+    r[0] = 0;
+    r[L] = 1;
+  } else {
+    for (i = 0; i < L; i++) r[i] = AMHBI_SSA_BASE - 1;
+  }
+}
+
+
+static void
+amhbi_ssa_sub (uint32_t *r, uint32_t *a, uint32_t *b, uint64_t L)
+{
+  uint32_t borrow = 0;
+  uint64_t i; for (i = 0; i <= L; i++) {
+    if (a[i] >= b[i] + borrow) {
+      r[i] = a[i] - b[i] - borrow;
+      borrow = 0;
+    } else {
+      r[i] = a[i] + AMHBI_SSA_BASE - b[i] - borrow;
+      borrow = 1;
+    }
+  }
+  
+  // A negative difference wrapped to 10^(8L + 8) - x; add 10^N + 1 instead
+  if (borrow) {
+    uint32_t carry = 1;
+    for (i = 0; i < L && carry; i++) {
+      r[i] += 1;
+      if (r[i] == AMHBI_SSA_BASE) r[i] = 0; else carry = 0;
+    }
+    r[L] = (r[L] + carry + 1) % AMHBI_SSA_BASE;
+  }
+}
+
+
+static void
+amhbi_ssa_shift (uint32_t *r, uint32_t *a, uint64_t s, uint64_t L, uint32_t *tmp)
+{
+  // Shifting by L limbs or more first negates, since 10^N = -1
+  uint8_t neg = (s >= L) ? 1 : 0;
+  if (neg) s -= L;
+  
+  // a * 10^(8s) = (low limbs moved up) - (limbs that overflowed past 10^N)
+  memset(r, 0, (L + 1) * sizeof(uint32_t));
+  memset(tmp, 0, (L + 1) * sizeof(uint32_t));
+  memcpy(&r[s], a, (L - s) * sizeof(uint32_t));
+  memcpy(tmp, &a[L - s], s * sizeof(uint32_t));
+  tmp[s] += a[L];
+  amhbi_ssa_sub(r, r, tmp, L);
+  
+  if (neg) {
+    memset(tmp, 0, (L + 1) * sizeof(uint32_t));
+    amhbi_ssa_sub(r, tmp, r, L);
+  }
+}
+
+
+static void
+amhbi_ssa_mulmod (uint32_t *r, uint32_t *a, uint32_t *b, uint64_t L)
+{
+  // 10^N = -1, so either operand being 10^N just negates the other
+  uint32_t *zero = calloc(2 * L + 2, sizeof(uint32_t));
+  assert(zero);
+  if (a[L] || b[L]) {
+    uint32_t *other = (a[L]) ? b : a;
+    if (a[L] && b[L]) {
+      memset(r, 0, (L + 1) * sizeof(uint32_t));
+      r[0] = 1;
+    } else {
+      amhbi_ssa_sub(r, zero, other, L);
+    }
+    free(zero);
+    return;
+  }
+  
+  // Otherwise recurse into the regular multiplication paths
+  amhbi_t *x = amhbi_ssa_to_bigint(a, L);
+  amhbi_t *y = amhbi_ssa_to_bigint(b, L);
+  amhbi_t *xy = amhbi_mult(x, y);
+  amhbi_free(2, x, y);
+  
+  // The product is below 10^2N; reduce it as low - high
+  uint32_t *lo = zero;
+  uint32_t *hi = &zero[L + 1];
+  uint64_t i; for (i = 0; i < 2 * L && i * AMHBI_SSA_DIGITS < amhbi_size(xy); i++) {
+    if (i < L) lo[i] = amhbi_ssa_limb(xy, i); else hi[i - L] = amhbi_ssa_limb(xy, i);
+  }
+  amhbi_free(1, xy);
+  amhbi_ssa_sub(r, lo, hi, L);
+  free(zero);
+}
+
+
+static amhbi_t *
+amhbi_ssa_to_bigint (uint32_t *a, uint64_t L)
+{
+  amhbi_t *num = amhbi_init_empty((L + 1) * AMHBI_SSA_DIGITS);
+  uint64_t i; for (i = 0; i <= L; i++) {
+    uint32_t limb = a[i];
+    uint64_t d; for (d = 0; d < AMHBI_SSA_DIGITS; d++) {
+      num->digits[(L + 1 - i) * AMHBI_SSA_DIGITS - d - 1] = (limb % 10) + '0';
+      limb /= 10;
+    }
+  }
+  return amhbi_trim(num);
+}
+
+
+static void
+amhbi_ssa_fft (uint32_t **a, uint64_t K, uint64_t L, uint8_t inverse, uint32_t *tmp)
+{
+  // The same schedule as the NTT: decimation in frequency forward and in
+  // time for the inverse, so elements never move, and the short levels done
+  // a block of elements at a time
+  uint64_t block = 2;
+  while (2 * block <= K && 2 * block * (L + 1) * sizeof(uint32_t) <= AMHBI_FFT_BLOCK) block *= 2;
+  if (block > K) block = K;
+  uint64_t lo, len;
+  if (!inverse) {
+    for (len = K; len > block; len >>= 1) amhbi_ssa_pass(a, L, 2 * L / len, len, 0, K, 0, tmp);
+    for (lo = 0; lo < K; lo += block) {
+      for (len = block; len >= 2; len >>= 1) amhbi_ssa_pass(a, L, 2 * L / len, len, lo, lo + block, 0, tmp);
+    }
+    return;
+  }
+  for (lo = 0; lo < K; lo += block) {
+    for (len = 2; len <= block; len <<= 1) amhbi_ssa_pass(a, L, 2 * L / len, len, lo, lo + block, 1, tmp);
+  }
+  for (len = 2 * block; len <= K; len <<= 1) amhbi_ssa_pass(a, L, 2 * L / len, len, 0, K, 1, tmp);
+}
+
+
+static void
+amhbi_ssa_pass (uint32_t **a, uint64_t L, uint64_t step, uint64_t len, uint64_t lo, uint64_t hi, uint8_t inverse, uint32_t *tmp)
+{
+  // The root of order len is 10^(2N / len), a shift of step = 2L / len
+  // limbs, and its inverse shifts the other way round 2L
+  uint32_t *v = tmp;
+  uint32_t *scratch = &tmp[L + 1];
+  uint64_t h = len / 2;
+  uint64_t i; for (i = lo; i < hi; i += len) {
+    uint64_t j; for (j = 0; j < h; j++) {
+      uint64_t e = j * step;
+      if (!inverse) {
+        amhbi_ssa_sub(v, a[i + j], a[i + j + h], L);
+        amhbi_ssa_add(a[i + j], a[i + j], a[i + j + h], L);
+        amhbi_ssa_shift(a[i + j + h], v, e, L, scratch);
+      } else {
+        amhbi_ssa_shift(v, a[i + j + h], (e) ? 2 * L - e : 0, L, scratch);
+        amhbi_ssa_sub(a[i + j + h], a[i + j], v, L);
+        amhbi_ssa_add(a[i + j], a[i + j], v, L);
+      }
+    }
+  }
+}
+
+
+amhbi_mulplan_t *
+amhbi_mulplan_init (amhbi_t *num, uint64_t maxsize)
+{
+  amhbi_mulplan_t *plan = calloc(1, sizeof(amhbi_mulplan_t));
+  assert(plan);
+  plan->num = amhbi_init_cpy(num);
+  
+  // Size the transform for the largest operand the plan should serve
+  uint64_t c1 = (amhbi_size(num) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (maxsize + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  plan->n = 1;
+  while (plan->n < c1 + c2) plan->n <<= 1;
+  
+  // Small or oversized operands are not worth a spectrum, and neither are
+  // products the floating-point FFT takes; it already needs only a forward
+  // and an inverse transform, which is all a spectrum would leave. In those
+  // cases mult falls back
+  if (amhbi_size(num) < 100 || plan->n > (1ULL << AMHBI_NTT_MAXLOG) ||
+    amhbi_size(num) + maxsize < AMHBI_DFFT_CUTOFF) {
+    plan->n = 0;
+    return plan;
+  }
+  
+  // Keep the forward transform of num modulo each prime
+  uint8_t p; for (p = 0; p < AMHBI_NTT_PRIMES; p++) {
+    plan->spectrum[p] = amhbi_split_ntt(num, plan->n);
+    amhbi_ntt(plan->spectrum[p], amhbi_ntt_plan(plan->n, p), 0);
+  }
+  return plan;
+}
+
+
+amhbi_t *
+amhbi_mulplan_mult (amhbi_mulplan_t *plan, amhbi_t *num)
+{
+  // Only operands whose product needs exactly this length and is too long
+  // for the floating-point FFT use the spectrum; anything smaller is cheaper
+  // with a shorter transform
+  uint64_t c1 = (amhbi_size(plan->num) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (amhbi_size(num) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  if (!plan->n || amhbi_size(num) < 100 || c1 + c2 > plan->n || 
+    c1 + c2 <= plan->n / 2 ||
+    amhbi_size(plan->num) + amhbi_size(num) < AMHBI_DFFT_CUTOFF) {
+    return amhbi_mult(plan->num, num);
+  }
+  
+  // One forward and one inverse transform per prime; the plan's spectrum
+  // stands in for the second forward transform
+  uint64_t *res[AMHBI_NTT_PRIMES];
+  uint64_t *one = amhbi_split_ntt(num, plan->n);
+  uint8_t p; for (p = 0; p < AMHBI_NTT_PRIMES; p++) {
+    amhbi_nttplan_t *ntt = amhbi_ntt_plan(plan->n, p);
+    res[p] = amhbi_alloc(plan->n * sizeof(uint64_t));
+    memcpy(res[p], one, plan->n * sizeof(uint64_t));
+    amhbi_ntt(res[p], ntt, 0);
+    uint64_t i; for (i = 0; i < plan->n; i++) {
+      res[p][i] = (res[p][i] * plan->spectrum[p][i]) % ntt->m;
+    }
+    amhbi_ntt(res[p], ntt, 1);
+  }
+  amhbi_dealloc(one);
+  
+  // Recover the product from its residues
+  amhbi_t *prod = amhbi_ntt_combine(res, plan->n, NULL);
+  for (p = 0; p < AMHBI_NTT_PRIMES; p++) amhbi_dealloc(res[p]);
+  if (!amhbi_iszero(prod)) {
+    prod->sign = (amhbi_sign(plan->num) == amhbi_sign(num)) ? 0 : 1;
+  }
+  return prod;
+}
+
+
+void
+amhbi_mulplan_free (amhbi_mulplan_t *plan)
+{
+  if (!plan) return;
+  uint8_t p; for (p = 0; p < AMHBI_NTT_PRIMES; p++) {
+    if (plan->spectrum[p]) amhbi_dealloc(plan->spectrum[p]);
+  }
+  amhbi_free(1, plan->num);
+  free(plan);
+}
+
+
+/*
+ * Short products; only the digits of a product that are asked for. Columns
+ * well below them are left out behind guard digits, and the exact product
+ * is only taken when the dropped columns could have carried into the rest
+ */
+
+amhbi_t *
+amhbi_mullo (amhbi_t *num1, amhbi_t *num2, uint64_t n)
+{
+  return amhbi_mulmid(num1, num2, 0, n);
+}
+
+
+amhbi_t *
+amhbi_mulhi (amhbi_t *num1, amhbi_t *num2, uint64_t n)
+{
+  return amhbi_mulmid(num1, num2, n, UINT64_MAX);
+}
+
+
+amhbi_t *
+amhbi_mulmid (amhbi_t *num1, amhbi_t *num2, uint64_t lo, uint64_t n)
+{
+  AMHBI_SPAN(AMHBI_PROBE_MULMID, amhbi_size(num1) + amhbi_size(num2));
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
+  uint64_t total = size1 + size2;
+  if (!n || lo >= total) return amhbi_init_zero();
+  uint64_t hi = (n > total - lo) ? total : lo + n;
+  uint8_t basecase = (size1 < AMHBI_SHORT_BASECASE || size2 < AMHBI_SHORT_BASECASE);
+  
+  // Every column is below 81 * min(size1, size2), so the columns under
+  // lo - g add up to less than 10^(lo - AMHBI_SHORT_GUARD) and can only
+  // matter when the digits kept below lo start with that many nines
+  uint64_t bound = 18 * ((size1 < size2) ? size1 : size2);
+  uint64_t g = AMHBI_SHORT_GUARD;
+  while (bound) {g++; bound /= 10;}
+  uint64_t cut = (lo > g) ? lo - g : 0;
+  
+  amhbi_t *res = NULL;
+  if (cut && basecase) {
+    amhbi_t *part = amhbi_mult_range(num1, num2, cut, hi);
+    res = amhbi_mulmid_take(part, lo - cut, hi - lo, 1, 0);
+    amhbi_free(1, part);
+  } else if (cut) {
+    res = amhbi_mulmid_transform(num1, num2, cut, lo, hi);
+  }
+  
+  // Nothing to leave out, or the guard digits were inconclusive; digits at
+  // or above hi never matter
+  if (!res) {
+    amhbi_t *part;
+    if (basecase) {
+      part = amhbi_mult_range(num1, num2, 0, hi);
+    } else {
+      amhbi_t *one = amhbi_slice(num1, 0, hi);
+      amhbi_t *two = amhbi_slice(num2, 0, hi);
+      part = amhbi_mult(one, two);
+      amhbi_free(2, one, two);
+    }
+    res = amhbi_slice(part, lo, hi - lo);
+    amhbi_free(1, part);
+  }
+  
+  // Set sign and return
+  if (!amhbi_iszero(res)) {
+    res->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+  }
+  return res;
+}
+
+
+/*
+ * Accumulators; terms are added into unnormalized base 10^8 columns with
+ * room for many carries, which are only propagated when the value is read
+ * or the columns could overflow
+ */
+
+amhbi_acc_t *
+amhbi_acc_init ()
+{
+  amhbi_acc_t *acc = calloc(1, sizeof(amhbi_acc_t));
+  assert(acc);
+  return acc;
+}
+
+
+void
+amhbi_acc_add (amhbi_acc_t *acc, amhbi_t *num)
+{
+  amhbi_acc_limbs(acc, num, 0);
+}
+
+
+void
+amhbi_acc_sub (amhbi_acc_t *acc, amhbi_t *num)
+{
+  amhbi_acc_limbs(acc, num, 1);
+}
+
+
+void
+amhbi_acc_add_int (amhbi_acc_t *acc, int64_t val)
+{
+  // Words have at most three limbs; the magnitude of INT64_MIN still fits
+  uint64_t mag = (val < 0) ? -(uint64_t)val : (uint64_t)val;
+  amhbi_acc_reserve(acc, 3, AMHBI_ACC_BASE);
+  unsigned __int128 *cols = acc->cols[val < 0];
+  uint64_t i; for (i = 0; mag; i++, mag /= AMHBI_ACC_BASE) cols[i] += mag % AMHBI_ACC_BASE;
+}
+
+
+void
+amhbi_acc_addmul (amhbi_acc_t *acc, amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_acc_term(acc, num1, num2, 0);
+}
+
+
+void
+amhbi_acc_submul (amhbi_acc_t *acc, amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_acc_term(acc, num1, num2, 1);
+}
+
+
+void
+amhbi_acc_merge (amhbi_acc_t *acc, amhbi_acc_t *other)
+{
+  if (other->bound > ~(unsigned __int128)0 - AMHBI_ACC_BASE) amhbi_acc_norm(other);
+  
+  // Only the columns in use, so that capacity does not grow with each merge
+  uint64_t size = other->size;
+  while (size && !other->cols[0][size - 1] && !other->cols[1][size - 1]) size--;
+  amhbi_acc_reserve(acc, size, other->bound);
+  uint8_t lane; for (lane = 0; lane < 2; lane++) {
+    uint64_t i; for (i = 0; i < size; i++) acc->cols[lane][i] += other->cols[lane][i];
+  }
+}
+
+
+amhbi_t *
+amhbi_acc_get (amhbi_acc_t *acc)
+{
+  // Once normalized, each column is exactly one limb of its lane, and the
+  // lanes compare by their highest differing column
+  amhbi_acc_norm(acc);
+  uint64_t n = acc->size;
+  while (n && acc->cols[0][n - 1] == acc->cols[1][n - 1]) n--;
+  if (!n) return amhbi_init_zero();
+  uint8_t neg = (acc->cols[1][n - 1] > acc->cols[0][n - 1]);
+  unsigned __int128 *big = acc->cols[neg];
+  unsigned __int128 *small = acc->cols[!neg];
+  
+  // First pass finds the top limb of the difference, so the result can be
+  // allocated at its exact length
+  uint64_t top = 0, topval = 0;
+  int64_t borrow = 0;
+  uint64_t i; for (i = 0; i < n; i++) {
+    int64_t limb = (int64_t)big[i] - (int64_t)small[i] - borrow;
+    borrow = (limb < 0);
+    limb += borrow * AMHBI_ACC_BASE;
+    if (limb) { top = i; topval = limb; }
+  }
+  uint64_t length = top * AMHBI_ACC_DIGITS;
+  while (topval) { length++; topval /= 10; }
+  
+  // Second pass writes the digits, least significant first
+  amhbi_t *res = amhbi_init_empty(length);
+  char *digit = &res->digits[length];
+  borrow = 0;
+  for (i = 0; i <= top; i++) {
+    int64_t limb = (int64_t)big[i] - (int64_t)small[i] - borrow;
+    borrow = (limb < 0);
+    limb += borrow * AMHBI_ACC_BASE;
+    uint8_t j; for (j = 0; j < AMHBI_ACC_DIGITS && digit > res->digits; j++, limb /= 10) *--digit = (limb % 10) + '0';
+  }
+  res->sign = neg;
+  return res;
+}
+
+
+void
+amhbi_acc_reset (amhbi_acc_t *acc)
+{
+  // Columns are kept for the next use
+  uint8_t lane; for (lane = 0; lane < 2 && acc->size; lane++) {
+    memset(acc->cols[lane], 0, acc->size * sizeof(unsigned __int128));
+  }
+  acc->bound = 0;
+}
+
+
+void
+amhbi_acc_free (amhbi_acc_t *acc)
+{
+  if (acc->size) {
+    amhbi_dealloc(acc->cols[0]);
+    amhbi_dealloc(acc->cols[1]);
+  }
+  free(acc);
+}
+
+
+static void
+amhbi_acc_reserve (amhbi_acc_t *acc, uint64_t size, unsigned __int128 add)
+{
+  // Normalizing leaves every column below 10^8, far from the top
+  if (acc->bound > ~(unsigned __int128)0 - add) amhbi_acc_norm(acc);
+  acc->bound += add;
+  if (size <= acc->size) return;
+  
+  // Capacity at least doubles, so columns are reallocated a few times only
+  if (size < 2 * acc->size) size = 2 * acc->size;
+  uint8_t lane; for (lane = 0; lane < 2; lane++) {
+    uint64_t bytes = size * sizeof(unsigned __int128);
+    acc->cols[lane] = (acc->size) ? amhbi_realloc(acc->cols[lane], bytes) : amhbi_alloc(bytes);
+    memset(&acc->cols[lane][acc->size], 0, (size - acc->size) * sizeof(unsigned __int128));
+  }
+  acc->size = size;
+}
+
+
+static void
+amhbi_acc_norm (amhbi_acc_t *acc)
+{
+  uint8_t lane; for (lane = 0; lane < 2; lane++) {
+    unsigned __int128 carry = 0;
+    uint64_t i; for (i = 0; i < acc->size || carry; i++) {
+      if (i == acc->size) amhbi_acc_reserve(acc, i + 1, 0);
+      carry += acc->cols[lane][i];
+      acc->cols[lane][i] = carry % AMHBI_ACC_BASE;
+      carry /= AMHBI_ACC_BASE;
+    }
+  }
+  acc->bound = AMHBI_ACC_BASE - 1;
+}
+
+
+static void
+amhbi_acc_limbs (amhbi_acc_t *acc, amhbi_t *num, uint8_t negate)
+{
+  if (amhbi_iszero(num)) return;
+  uint64_t n = (amhbi_size(num) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  amhbi_acc_reserve(acc, n, AMHBI_ACC_BASE);
+  unsigned __int128 *cols = acc->cols[amhbi_sign(num) ^ negate];
+  uint64_t i; for (i = 0; i < n; i++) cols[i] += amhbi_acc_limb(num, i);
+}
+
+
+static void
+amhbi_acc_term (amhbi_acc_t *acc, amhbi_t *num1, amhbi_t *num2, uint8_t negate)
+{
+  if (amhbi_iszero(num1) || amhbi_iszero(num2)) return;
+  uint64_t n1 = (amhbi_size(num1) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  uint64_t n2 = (amhbi_size(num2) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  
+  // Longer terms go through the usual multiplication tiers
+  if (n1 > AMHBI_ACC_LIMBS || n2 > AMHBI_ACC_LIMBS) {
+    amhbi_t *prod = amhbi_mult(num1, num2);
+    amhbi_acc_limbs(acc, prod, negate);
+    amhbi_free(1, prod);
+    return;
+  }
+  
+  // Short terms are multiplied limb by limb straight into the columns,
+  // each column gaining at most min(n1, n2) limb products
+  unsigned __int128 max = (AMHBI_ACC_BASE - 1ULL) * (AMHBI_ACC_BASE - 1ULL);
+  amhbi_acc_reserve(acc, n1 + n2, max * ((n1 < n2) ? n1 : n2));
+  amhbi_acc_kernel(acc->cols[amhbi_sign(num1) ^ amhbi_sign(num2) ^ negate], num1, num2);
+}
+
+
+static uint64_t
+amhbi_acc_limb (amhbi_t *num, uint64_t i)
+{
+  uint64_t end = amhbi_size(num) - i * AMHBI_ACC_DIGITS;
+  uint64_t start = (end > AMHBI_ACC_DIGITS) ? end - AMHBI_ACC_DIGITS : 0;
+  uint64_t limb = 0;
+  uint64_t j; for (j = start; j < end; j++) limb = limb * 10 + (num->digits[j] - '0');
+  return limb;
+}
+
+
+static void
+amhbi_acc_kernel (unsigned __int128 *cols, amhbi_t *num1, amhbi_t *num2)
+{
+  uint64_t n1 = (amhbi_size(num1) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  uint64_t n2 = (amhbi_size(num2) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  assert(n1 <= AMHBI_ACC_LIMBS && n2 <= AMHBI_ACC_LIMBS);
+  uint64_t a[AMHBI_ACC_LIMBS];
+  uint64_t b[AMHBI_ACC_LIMBS];
+  uint64_t i; for (i = 0; i < n1; i++) a[i] = amhbi_acc_limb(num1, i);
+  for (i = 0; i < n2; i++) b[i] = amhbi_acc_limb(num2, i);
+  for (i = 0; i < n1; i++) {
+    uint64_t j; for (j = 0; j < n2; j++) cols[i + j] += a[i] * b[j];
+  }
+}
+
+
+/*
+ * Multiply-accumulate; products are added into the digits of acc in place,
+ * and dot products are summed in one accumulator per thread
+ */
+
+amhbi_t *
+amhbi_addmul (amhbi_t *acc, amhbi_t *num1, amhbi_t *num2)
+{
+  return amhbi_addmul_to(acc, num1, num2, 0);
+}
+
+
+amhbi_t *
+amhbi_submul (amhbi_t *acc, amhbi_t *num1, amhbi_t *num2)
+{
+  return amhbi_addmul_to(acc, num1, num2, 1);
+}
+
+
+amhbi_t *
+amhbi_dot (uint64_t n, amhbi_t *num1[], amhbi_t *num2[])
+{
+  // One contiguous chunk of terms per thread, none smaller than
+  // AMHBI_DOT_CHUNK terms
+  uint64_t count = amhbi_get_threads();
+  if (count > n / AMHBI_DOT_CHUNK) count = n / AMHBI_DOT_CHUNK;
+  if (!count) count = 1;
+  amhbi_dot_job_t *jobs = calloc(count, sizeof(amhbi_dot_job_t));
+  assert(jobs);
+  uint64_t i; for (i = 0; i < count; i++) {
+    jobs[i].num1 = num1;
+    jobs[i].num2 = num2;
+    jobs[i].lo = n * i / count;
+    jobs[i].hi = n * (i + 1) / count;
+    jobs[i].acc = amhbi_acc_init();
+    jobs[i].id = i;
+    jobs[i].count = count;
+  }
+  
+  // Threads are started from the last, so the ids of the jobs each one
+  // joins are already set when it starts
+  for (i = count - 1; i > 0; i--) {
+    int ok = pthread_create(&jobs[i].thread, NULL, amhbi_dot_worker, &jobs[i]);
+    assert(!ok);
+  }
+  
+  // The first chunk runs here, and ends up holding every other chunk
+  amhbi_dot_worker(&jobs[0]);
+  amhbi_t *res = amhbi_acc_get(jobs[0].acc);
+  for (i = 0; i < count; i++) amhbi_acc_free(jobs[i].acc);
+  free(jobs);
+  return res;
+}
+
+
+static void *
+amhbi_dot_worker (void *arg)
+{
+  amhbi_dot_job_t *job = arg;
+  uint64_t i; for (i = job->lo; i < job->hi; i++) {
+    amhbi_acc_addmul(job->acc, job->num1[i], job->num2[i]);
+  }
+  
+  // Tree reduction; job k waits for and merges job k + step for each step
+  // below its lowest set bit, so the merges run log2(count) levels deep
+  amhbi_dot_job_t *jobs = job - job->id;
+  uint64_t step; for (step = 1; !(job->id & step) && job->id + step < job->count; step <<= 1) {
+    int ok = pthread_join(jobs[job->id + step].thread, NULL);
+    assert(!ok);
+    amhbi_acc_merge(job->acc, jobs[job->id + step].acc);
+  }
+  return NULL;
+}
+
+
+static amhbi_t *
+amhbi_addmul_to (amhbi_t *num, amhbi_t *num1, amhbi_t *num2, uint8_t negate)
+{
+  if (amhbi_iszero(num1) || amhbi_iszero(num2)) return num;
+  uint8_t sign = amhbi_sign(num1) ^ amhbi_sign(num2) ^ negate;
+  uint64_t n1 = (amhbi_size(num1) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  uint64_t n2 = (amhbi_size(num2) + AMHBI_ACC_DIGITS - 1) / AMHBI_ACC_DIGITS;
+  
+  // Longer terms go through the usual multiplication tiers
+  if (n1 > AMHBI_ACC_LIMBS || n2 > AMHBI_ACC_LIMBS) {
+    amhbi_t *prod = amhbi_mult(num1, num2);
+    amhbi_add_to(num, prod->digits, amhbi_size(prod), sign);
+    amhbi_free(1, prod);
+    return num;
+  }
+  
+  // Short terms are multiplied into columns on the stack; no column passes
+  // AMHBI_ACC_LIMBS * 10^16, so the carries fit in a word
+  unsigned __int128 cols[2 * AMHBI_ACC_LIMBS] = {0};
+  char digits[2 * AMHBI_ACC_LIMBS * AMHBI_ACC_DIGITS];
+  amhbi_acc_kernel(cols, num1, num2);
+  char *digit = &digits[sizeof(digits)];
+  uint64_t carry = 0;
+  uint64_t i; for (i = 0; i < n1 + n2; i++) {
+    carry += (uint64_t)cols[i];
+    uint64_t limb = carry % AMHBI_ACC_BASE;
+    carry /= AMHBI_ACC_BASE;
+    uint8_t j; for (j = 0; j < AMHBI_ACC_DIGITS; j++, limb /= 10) *--digit = (limb % 10) + '0';
+  }
+  while (*digit == '0') digit++;
+  return amhbi_add_to(num, digit, &digits[sizeof(digits)] - digit, sign);
+}
+
+
+static amhbi_t *
+amhbi_add_to (amhbi_t *num, char *digits, uint64_t tsize, uint8_t sign)
+{
+  amhbi_own(num);
+  if (amhbi_iszero(num)) num->sign = sign;
+  
+  // Leading zeros make room for every digit of term, plus a carry
+  uint64_t size = amhbi_size(num);
+  if (size <= tsize) {
+    uint64_t grow = tsize + 1 - size;
+    num->digits = amhbi_realloc(num->digits, tsize + 2);
+    memmove(&num->digits[grow], num->digits, size + 1);
+    memset(num->digits, '0', grow);
+    num->length = size = tsize + 1;
+  }
+  
+  uint64_t i;
+  if (sign == num->sign) {
+    // Same signs add magnitudes; a carry out of the top lengthens num
+    uint8_t carry = 0;
+    for (i = 0; i < tsize || (carry && i < size); i++) {
+      uint8_t d = (num->digits[size - 1 - i] - '0') + carry;
+      if (i < tsize) d += digits[tsize - 1 - i] - '0';
+      carry = (d >= 10);
+      num->digits[size - 1 - i] = (d - 10 * carry) + '0';
+    }
+    if (carry) {
+      num->digits = amhbi_realloc(num->digits, size + 2);
+      memmove(&num->digits[1], num->digits, size + 1);
+      num->digits[0] = '1';
+      num->length = size + 1;
+    }
+  } else {
+    // Opposite signs subtract magnitudes; a borrow out of the top means
+    // term was the larger, leaving 10^size minus the result's magnitude
+    uint8_t borrow = 0;
+    for (i = 0; i < tsize || (borrow && i < size); i++) {
+      int8_t d = (num->digits[size - 1 - i] - '0') - borrow;
+      if (i < tsize) d -= digits[tsize - 1 - i] - '0';
+      borrow = (d < 0);
+      num->digits[size - 1 - i] = (d + 10 * borrow) + '0';
+    }
+    if (borrow) {
+      num->sign ^= 1;
+      for (i = 0; num->digits[size - 1 - i] == '0'; i++);
+      num->digits[size - 1 - i] = ('9' - num->digits[size - 1 - i]) + '1';
+      for (i++; i < size; i++) num->digits[size - 1 - i] = '9' - num->digits[size - 1 - i] + '0';
+    }
+  }
+  
+  // Only shift the digits down when there are leading zeros to drop
+  if (num->digits[0] == '0') {
+    uint64_t lead; for (lead = 0; lead < num->length - 1 && num->digits[lead] == '0'; lead++);
+    memmove(num->digits, &num->digits[lead], num->length - lead + 1);
+    num->length -= lead;
+    if (amhbi_iszero(num)) num->sign = 0;
+  }
+  return num;
+}
+
+
+static amhbi_t *
+amhbi_pow_calc (amhbi_t *num, amhbi_t *p)
+{
+  amhbi_t *res = amhbi_init_str("1");
+  amhbi_t *a = amhbi_init_cpy(num);
+  amhbi_t *b = amhbi_init_cpy(p);
+
+  // Perform iterated exponentiation by squaring
+  while (!amhbi_iszero(b)) {
+    if (amhbi_isodd(b)) {
+      // res *= a
+      amhbi_t *tmp = amhbi_mult(res, a); 
+      amhbi_free(1, res); 
+      res = tmp;
+      // b -= 1
+      amhbi_decr(b);
+    }
+    // b /= 2
+    amhbi_t *tmp = amhbi_half(b); 
+    amhbi_free(1, b); 
+    b = tmp;
+    // a *= a, unless no bits are left to use it
+    if (amhbi_iszero(b)) break;
+    tmp = amhbi_mult(a, a); 
+    amhbi_free(1, a); 
+    a = tmp;
+  }
+  
+  amhbi_free(2, a, b);
+  return res;
+}
+
+
+static amhbi_t **
+amhbi_div (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_DIV, amhbi_size(num1));
+  // Long division is fine for short divisors; past that, multiply by an
+  // approximate reciprocal
+  if (amhbi_size(num2) < AMHBI_NEWTON_THRESHOLD || amhbi_size(num1) < amhbi_size(num2)) {
+    return amhbi_div_long(num1, num2);
+  }
+  return amhbi_div_newton(num1, num2);
+}
+
+
+static amhbi_t **
+amhbi_div_long (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_DIV_LONG, amhbi_size(num1));
+  // Create array of results (quotient, remainder)
+  amhbi_t **res = calloc(2, sizeof(amhbi_t *));
+  assert(res);
+  
+  amhbi_t *tmpnum2 = amhbi_abs(num2);
+  amhbi_t *quo = amhbi_init_empty(amhbi_size(num1));
+  amhbi_t *rem = amhbi_init_zero();
+  
+  // Long division; bring down one digit at a time, then subtract the
+  // divisor as many times as it fits to get the next quotient digit
+  uint64_t i; for (i = 0; i < amhbi_size(num1); i++) {
+    amhbi_mult_pow10_to(rem, 1);
+    rem->digits[amhbi_size(rem) - 1] = num1->digits[i];
+    char digit = '0';
+    while (amhbi_cmp(rem, tmpnum2) >= 0) {
+      amhbi_t *tmp = amhbi_subt(rem, tmpnum2);
+      amhbi_free(1, rem);
+      rem = tmp;
+      digit++;
+    }
+    quo->digits[i] = digit;
+  }
+  amhbi_free(1, tmpnum2);
+  
+  // Set quotient (+ sign) and remainder
+  res[0] = amhbi_trim(quo); res[1] = rem;
+  if (!amhbi_iszero(quo) && amhbi_sign(num1) != amhbi_sign(num2)) {
+    res[0]->sign = 1;
+  }
+  return res;
+}
+
+
+static amhbi_t **
+amhbi_div_newton (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_DIV_NEWTON, amhbi_size(num1));
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
+  
+  // The quotient has at most size1 - size2 + 1 digits, so the reciprocal
+  // needs that many digits plus a few guard digits. Quotients much longer
+  // than the divisor are found l digits at a time instead, which only
+  // takes l + 1 digits of reciprocal, and the one reciprocal serves every
+  // block. A shorter divisor is padded with zeros, a longer one only has
+  // its leading digits used
+  uint64_t n = size1 - size2 + 1;
+  uint64_t l = (size2 > AMHBI_DIV_BLOCK) ? size2 : AMHBI_DIV_BLOCK;
+  uint8_t blocks = (n >= AMHBI_DIV_BLOCKS * l) ? 1 : 0;
+  uint64_t k = ((blocks) ? l + 1 : n) + AMHBI_NEWTON_GUARD;
+  amhbi_t *top;
+  if (k <= size2) {
+    top = amhbi_slice(num2, size2 - k, k);
+  } else {
+    top = amhbi_mult_pow10_to(amhbi_slice(num2, 0, size2), k - size2);
+  }
+  amhbi_t *recip = amhbi_recip(top, k);
+  amhbi_free(1, top);
+  amhbi_t **res;
+  if (blocks) {
+    res = amhbi_div_blocks(num1, num2, recip, k, l);
+  } else {
+    res = amhbi_div_recip(num1, num2, recip, k);
+  }
+  amhbi_free(1, recip);
+  
+  // Set the quotient's sign
+  if (!amhbi_iszero(res[0]) && amhbi_sign(num1) != amhbi_sign(num2)) {
+    res[0]->sign = 1;
+  }
+  return res;
+}
+
+
+static amhbi_t **
+amhbi_div_blocks (amhbi_t *num1, amhbi_t *num2, amhbi_t *recip, uint64_t k, uint64_t l)
+{
+  // Blocks of l digits from the top; each partial dividend is the last
+  // remainder followed by the next l digits, so its quotient fits l digits
+  uint64_t blocks = (amhbi_size(num1) + l - 1) / l;
+  amhbi_t *quo = amhbi_init_empty(blocks * l);
+  amhbi_t *rem = amhbi_init_zero();
+  uint64_t i; for (i = blocks; i-- > 0;) {
+    amhbi_t *chunk = amhbi_slice(num1, i * l, l);
+    amhbi_mult_pow10_to(rem, l);
+    amhbi_t *part = amhbi_add(rem, chunk);
+    amhbi_t **qr = amhbi_div_recip(part, num2, recip, k);
+    amhbi_free(3, chunk, rem, part);
+    
+    char *end = &quo->digits[(blocks - i) * l];
+    uint64_t size = amhbi_size(qr[0]);
+    memset(end - l, '0', l - size);
+    memcpy(end - size, qr[0]->digits, size);
+    rem = qr[1];
+    amhbi_free(1, qr[0]); free(qr);
+  }
+  
+  // Create array of results (quotient, remainder)
+  amhbi_t **res = calloc(2, sizeof(amhbi_t *));
+  assert(res);
+  res[0] = amhbi_trim(quo); res[1] = rem;
+  return res;
+}
+
+
+static amhbi_t **
+amhbi_div_recip (amhbi_t *num1, amhbi_t *num2, amhbi_t *recip, uint64_t k)
+{
+  uint64_t size1 = amhbi_size(num1);
+  uint64_t size2 = amhbi_size(num2);
+  
+  // Create array of results (quotient, remainder)
+  amhbi_t **res = calloc(2, sizeof(amhbi_t *));
+  assert(res);
+  
+  // num1 is scaled like the divisor's top k digits were
+  amhbi_t *high;
+  if (k <= size2) {
+    high = amhbi_slice(num1, size2 - k, UINT64_MAX);
+  } else {
+    high = amhbi_mult_pow10_to(amhbi_slice(num1, 0, size1), k - size2);
+  }
+  
+  // Then floor(high * recip / 10^2k) is within a couple of units of the
+  // quotient, and only the top half of that product is needed
+  amhbi_t *quo = amhbi_mulhi(high, recip, 2 * k);
+  amhbi_free(1, high);
+  
+  // The remainder num1 - quo * num2 is then small, so it is known from the
+  // product modulo anything over twice its size; a cyclic product of
+  // length N gives it modulo 10^N - 1 once the full product is too long
+  // for the floating-point FFT, otherwise the low size2 + 2 digits do
+  amhbi_t *div = amhbi_abs(num2);
+  amhbi_t *rem, *mod;
+  uint64_t c1 = (amhbi_size(quo) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (size2 + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t nf = 1, nw = 1;
+  while (nf < c1 + c2) nf <<= 1;
+  while (nw * AMHBI_NTT_DIGITS < size2 + 3) nw <<= 1;
+  if (size1 >= AMHBI_DFFT_CUTOFF && nw < nf && nw <= (1ULL << AMHBI_NTT_MAXLOG)) {
+    mod = amhbi_init_empty(nw * AMHBI_NTT_DIGITS);
+    memset(mod->digits, '9', nw * AMHBI_NTT_DIGITS);
+    amhbi_t *low = amhbi_fold(num1, nw * AMHBI_NTT_DIGITS);
+    amhbi_t *short_quo = amhbi_fold(quo, nw * AMHBI_NTT_DIGITS);
+    amhbi_t *prod = amhbi_mult_wrap(short_quo, div, nw);
+    rem = amhbi_subt(low, prod);
+    amhbi_free(3, low, short_quo, prod);
+  } else {
+    mod = amhbi_mult_pow10_to(amhbi_init_int(1), size2 + 2);
+    amhbi_t *low = amhbi_slice(num1, 0, size2 + 2);
+    amhbi_t *prod = amhbi_mullo(quo, div, size2 + 2);
+    rem = amhbi_subt(low, prod);
+    amhbi_free(2, low, prod);
+  }
+  rem = amhbi_centre(rem, mod);
+  amhbi_free(1, mod);
+  
+  // Fix up the last couple of units
+  uint8_t steps = 0;
+  while (amhbi_sign(rem)) {
+    amhbi_t *tmp = amhbi_add(rem, div);
+    amhbi_free(1, rem);
+    rem = tmp;
+    quo = amhbi_decr(quo);
+    assert(++steps < 50);
+  }
+  while (amhbi_cmp(rem, div) >= 0) {
+    amhbi_t *tmp = amhbi_subt(rem, div);
+    amhbi_free(1, rem);
+    rem = tmp;
+    quo = amhbi_incr(quo);
+    assert(++steps < 50);
+  }
+  amhbi_free(1, div);
+  
+  // Set quotient and remainder
+  res[0] = quo; res[1] = rem;
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_recip (amhbi_t *num, uint64_t k)
+{
+  AMHBI_SPAN(AMHBI_PROBE_RECIP, k);
+  // Short reciprocals come straight from long division
+  if (k <= AMHBI_RECIP_BASECASE) {
+    amhbi_t *one = amhbi_mult_pow10_to(amhbi_init_int(1), 2 * k);
+    amhbi_t **res = amhbi_div_long(one, num);
+    amhbi_t *recip = res[0];
+    amhbi_free(2, one, res[1]); free(res);
+    return recip;
+  }
+  
+  // Start from the reciprocal of the leading h digits; one Newton step
+  // squares its relative error, which leaves a few units in the last place
+  uint64_t h = (k + 6) / 2;
+  amhbi_t *top = amhbi_slice(num, k - h, h);
+  amhbi_t *rh = amhbi_recip(top, h);
+  amhbi_free(1, top);
+  
+  // The step is recip = rh * 10^(k - h) + rh * e / 10^2h, where
+  // e = 10^(k + h) - num * rh. The leading h digits of num * rh cancel and
+  // |e| < 10^(k + 3), so once the product is long a cyclic one of length
+  // N >= k + 4 is enough to find e
+  amhbi_t *err;
+  uint64_t c1 = (k + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t c2 = (amhbi_size(rh) + AMHBI_NTT_DIGITS - 1) / AMHBI_NTT_DIGITS;
+  uint64_t nf = 1, nw = 1;
+  while (nf < c1 + c2) nf <<= 1;
+  while (nw * AMHBI_NTT_DIGITS < k + 4) nw <<= 1;
+  if (k + h >= AMHBI_DFFT_CUTOFF && nw < nf && nw <= (1ULL << AMHBI_NTT_MAXLOG)) {
+    uint64_t N = nw * AMHBI_NTT_DIGITS;
+    amhbi_t *mod = amhbi_init_empty(N);
+    memset(mod->digits, '9', N);
+    amhbi_t *one = amhbi_mult_pow10_to(amhbi_init_int(1), (k + h) % N);
+    amhbi_t *prod = amhbi_mult_wrap(num, rh, nw);
+    err = amhbi_centre(amhbi_subt(one, prod), mod);
+    amhbi_free(3, mod, one, prod);
+  } else {
+    amhbi_t *one = amhbi_mult_pow10_to(amhbi_init_int(1), k + h);
+    amhbi_t *prod = amhbi_mult(num, rh);
+    err = amhbi_subt(one, prod);
+    amhbi_free(2, one, prod);
+  }
+  
+  // Only the top of rh * e survives the division by 10^2h
+  amhbi_t *corr = amhbi_mulhi(rh, err, 2 * h);
+  amhbi_t *recip = amhbi_add(amhbi_mult_pow10_to(rh, k - h), corr);
+  amhbi_free(3, rh, err, corr);
+  return recip;
+}
+
+
+static amhbi_t *
+amhbi_centre (amhbi_t *num, amhbi_t *mod)
+{
+  // Move num by mod towards zero while that shrinks it
+  amhbi_t *twice = amhbi_add(num, num);
+  amhbi_t *absn = amhbi_abs(twice);
+  uint8_t far = (amhbi_cmp(absn, mod) > 0);
+  amhbi_free(2, twice, absn);
+  if (!far) return num;
+  amhbi_t *res = (amhbi_sign(num)) ? amhbi_add(num, mod) : amhbi_subt(num, mod);
+  amhbi_free(1, num);
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_fold (amhbi_t *num, uint64_t N)
+{
+  // Since 10^N = 1 modulo 10^N - 1, the N digit blocks of num just add up
+  amhbi_t *res = amhbi_init_zero();
+  uint64_t lo; for (lo = 0; lo < amhbi_size(num); lo += N) {
+    amhbi_t *block = amhbi_slice(num, lo, N);
+    amhbi_t *tmp = amhbi_add(res, block);
+    amhbi_free(2, res, block);
+    res = tmp;
+  }
+  if (amhbi_size(res) > N) {
+    amhbi_t *tmp = amhbi_fold(res, N);
+    amhbi_free(1, res);
+    res = tmp;
+  }
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_quo_calc (amhbi_t *num1, amhbi_t *num2)
+{
+  assert(!amhbi_iszero(num2));
+  if (!amhbi_cmp(num1, num2)) return amhbi_init_int(1);
+  amhbi_t **res = amhbi_div(num1, num2);
+  amhbi_t *quo = res[0]; amhbi_t *rem = res[1];
+  amhbi_free(1, rem); free(res);
+  return quo;
+}
+
+
+static amhbi_t *
+amhbi_rem_calc (amhbi_t *num1, amhbi_t *num2)
+{
+  assert(!amhbi_iszero(num2));
+  amhbi_t **res = amhbi_div(num1, num2);
+  amhbi_t *quo = res[0]; amhbi_t *rem = res[1];
+  amhbi_free(1, quo); free(res);
+  
+  // Adjust result based on signs; the remainder takes the divisor's sign
+  if (amhbi_iszero(rem)) {
+    return rem;
+  } else if (amhbi_isneg(num1) && amhbi_isneg(num2)) {
+    amhbi_t *tmp = amhbi_negate(rem);
+    amhbi_free(1, rem);
+    return tmp;
+  } else if (amhbi_isneg(num1) && !amhbi_isneg(num2)) {
+    amhbi_t *tmp = amhbi_subt(num2, rem);
+    amhbi_free(1, rem);
+    return tmp;
+  } else if (!amhbi_isneg(num1) && amhbi_isneg(num2)) {
+    amhbi_t *tmp = amhbi_add(num2, rem);
+    amhbi_free(1, rem);
+    return tmp;
+  } else {
+    return rem;
+  }
+}
+
+
+/*
+ * Exact division; when the remainder is known to be zero the quotient is
+ * found from the low digits up, as num1 times the inverse of num2 modulo
+ * 10^n, so only the low n digits of either operand are ever read
+ */
+
+amhbi_t *
+amhbi_divexact (amhbi_t *num1, amhbi_t *num2)
+{
+  assert(!amhbi_iszero(num2));
+  uint8_t sign = amhbi_sign(num1) ^ amhbi_sign(num2);
+  if (amhbi_iszero(num1)) return amhbi_init_zero();
+  
+  // Trailing zeros of the divisor come off both operands
+  uint64_t size2 = amhbi_size(num2);
+  uint64_t zeros = 0;
+  while (num2->digits[size2 - 1 - zeros] == '0') zeros++;
+  amhbi_t *a = amhbi_slice(num1, zeros, amhbi_size(num1));
+  amhbi_t *b = amhbi_slice(num2, zeros, size2);
+  
+  // A power of 2 (or 5) left in the divisor turns into a power of 10 once
+  // both operands are multiplied by as many 5s (or 2s). The exponent is the
+  // number of zeros (b mod 10^k) 5^k (or 2^k) ends in, for k doubled until
+  // it exceeds them; then one multiplication of each operand takes it all
+  // out, unless the power is so large that plain division is cheaper
+  uint8_t last = b->digits[amhbi_size(b) - 1] - '0';
+  uint8_t plain = 0;
+  if (!(last % 2) || last == 5) {
+    amhbi_t *f = amhbi_init_uint((last == 5) ? 2 : 5);
+    uint64_t k = 18, v;
+    while (1) {
+      amhbi_t *kk = amhbi_init_uint(k);
+      amhbi_t *m = amhbi_pow_calc(f, kk);
+      amhbi_t *low = amhbi_slice(b, 0, k);
+      amhbi_t *y = amhbi_mult(low, m);
+      uint64_t size = amhbi_size(y);
+      for (v = 0; v < k && y->digits[size - 1 - v] == '0'; v++);
+      amhbi_free(4, kk, m, low, y);
+      if (v < k || k > AMHBI_DIVEXACT_BASECASE) break;
+      k *= 2;
+    }
+    plain = (v > AMHBI_DIVEXACT_BASECASE) ? 1 : 0;
+    if (!plain) {
+      amhbi_t *vv = amhbi_init_uint(v);
+      amhbi_t *m = amhbi_pow_calc(f, vv);
+      amhbi_t *x = amhbi_mult(a, m);
+      amhbi_t *y = amhbi_mult(b, m);
+      amhbi_free(4, a, b, vv, m);
+      a = amhbi_slice(x, v, amhbi_size(x));
+      b = amhbi_slice(y, v, amhbi_size(y));
+      amhbi_free(2, x, y);
+    }
+    amhbi_free(1, f);
+  }
+  
+  // Otherwise the quotient has at most n digits; short divisors go limb by
+  // limb and short quotients by the basecase. Long ones are found a divisor
+  // length at a time from one inverse when the divisor is long enough for
+  // that to beat blockwise division, and from a full Hensel inverse where
+  // that beats division; everything else is plain division
+  amhbi_t *res;
+  uint64_t size1 = amhbi_size(a);
+  size2 = amhbi_size(b);
+  uint64_t n = (size1 < size2) ? 0 : size1 - size2 + 1;
+  uint8_t blocks = (n >= AMHBI_DIVEXACT_BLOCKS * size2) ? 1 : 0;
+  if (plain) {
+    res = amhbi_quo_calc(a, b);
+  } else if (!n) {
+    res = amhbi_init_zero();
+  } else if (size2 <= AMHBI_SSA_DIGITS) {
+    res = amhbi_divexact_limb(a, amhbi_ssa_limb(b, 0));
+  } else if (n <= AMHBI_DIVEXACT_BASECASE) {
+    res = amhbi_divexact_basecase(a, b, n);
+  } else if (blocks && size2 >= AMHBI_DIV_BLOCK) {
+    res = amhbi_divexact_blocks(a, b, n);
+  } else if (!blocks && n <= AMHBI_DIVEXACT_HENSEL) {
+    amhbi_t *lowb = amhbi_slice(b, 0, n);
+    amhbi_t *lowa = amhbi_slice(a, 0, n);
+    amhbi_t *inv = amhbi_invmod_pow10(lowb, n);
+    res = amhbi_mullo(lowa, inv, n);
+    amhbi_free(3, lowb, lowa, inv);
+  } else {
+    res = amhbi_quo_calc(a, b);
+  }
+  amhbi_free(2, a, b);
+  if (!amhbi_iszero(res)) res->sign = sign;
+  return res;
+}
+
+
+amhbi_t *
+amhbi_divexact_ui (amhbi_t *num, uint64_t d)
+{
+  assert(d);
+  uint8_t sign = amhbi_sign(num);
+  
+  // Divisors coprime to 10 that fit a limb take the Hensel loop; the rest
+  // are divided from the top, eighteen digits at a time
+  amhbi_t *res;
+  if (d < AMHBI_SSA_BASE && d % 2 && d % 5) {
+    res = amhbi_divexact_limb(num, d);
+  } else {
+    uint64_t size = amhbi_size(num);
+    res = amhbi_init_empty(size);
+    unsigned __int128 rem = 0;
+    uint64_t i = 0;
+    while (i < size) {
+      uint64_t k = (size - i) % 18;
+      if (!k) k = 18;
+      uint64_t chunk = 0, scale = 1;
+      uint64_t j; for (j = 0; j < k; j++, scale *= 10) chunk = chunk * 10 + (num->digits[i + j] - '0');
+      unsigned __int128 cur = rem * scale + chunk;
+      uint64_t q = cur / d;
+      rem = cur % d;
+      for (j = k; j-- > 0; q /= 10) res->digits[i + j] = (q % 10) + '0';
+      i += k;
+    }
+    amhbi_trim(res);
+  }
+  if (!amhbi_iszero(res)) res->sign = sign;
+  return res;
+}
+
+
+static uint64_t
+amhbi_inv_limb (uint64_t d)
+{
+  // Newton's iteration doubles the digits of 1 / d modulo 10^k each step
+  static const uint8_t inv[10] = {0, 1, 0, 7, 0, 0, 0, 3, 0, 9};
+  uint64_t x = inv[d % 10];
+  d %= AMHBI_SSA_BASE;
+  uint8_t k; for (k = 0; k < 3; k++) {
+    uint64_t t = d * x % AMHBI_SSA_BASE;
+    x = x * ((2 + AMHBI_SSA_BASE - t) % AMHBI_SSA_BASE) % AMHBI_SSA_BASE;
+  }
+  return x;
+}
+
+
+static amhbi_t *
+amhbi_divexact_limb (amhbi_t *num, uint64_t d)
+{
+  // Each quotient limb clears the lowest limb left; what q d leaves above
+  // it is carried into the next one
+  uint64_t n = (amhbi_size(num) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  uint64_t dinv = amhbi_inv_limb(d);
+  amhbi_t *res = amhbi_init_empty(n * AMHBI_SSA_DIGITS);
+  char *digit = &res->digits[n * AMHBI_SSA_DIGITS];
+  uint64_t carry = 0;
+  uint64_t i; for (i = 0; i < n; i++) {
+    uint64_t limb = amhbi_ssa_limb(num, i);
+    uint64_t borrow = (limb < carry);
+    uint64_t x = limb + borrow * AMHBI_SSA_BASE - carry;
+    uint64_t q = x * dinv % AMHBI_SSA_BASE;
+    carry = (q * d - x) / AMHBI_SSA_BASE + borrow;
+    uint8_t j; for (j = 0; j < AMHBI_SSA_DIGITS; j++, q /= 10) *--digit = (q % 10) + '0';
+  }
+  return amhbi_trim(res);
+}
+
+
+static amhbi_t *
+amhbi_divexact_basecase (amhbi_t *num1, amhbi_t *num2, uint64_t n)
+{
+  // Only the low limbs of the quotient's length take part; each quotient
+  // limb zeroes one more limb of the running remainder
+  uint64_t nq = (n + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  uint64_t n1 = (amhbi_size(num1) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  uint64_t n2 = (amhbi_size(num2) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  int64_t r[nq];
+  uint64_t b[nq];
+  uint64_t i; for (i = 0; i < nq; i++) {
+    r[i] = (i < n1) ? amhbi_ssa_limb(num1, i) : 0;
+    b[i] = (i < n2) ? amhbi_ssa_limb(num2, i) : 0;
+  }
+  uint64_t binv = amhbi_inv_limb(b[0]);
+  amhbi_t *res = amhbi_init_empty(nq * AMHBI_SSA_DIGITS);
+  char *digit = &res->digits[nq * AMHBI_SSA_DIGITS];
+  for (i = 0; i < nq; i++) {
+    uint64_t q = (uint64_t)r[i] * binv % AMHBI_SSA_BASE;
+    int64_t carry = 0;
+    uint64_t j; for (j = 0; i + j < nq; j++) {
+      int64_t t = r[i + j] - carry - (int64_t)(q * b[j]);
+      int64_t c = (t >= 0) ? t / AMHBI_SSA_BASE : -((-t + AMHBI_SSA_BASE - 1) / AMHBI_SSA_BASE);
+      r[i + j] = t - c * AMHBI_SSA_BASE;
+      carry = -c;
+    }
+    uint8_t k; for (k = 0; k < AMHBI_SSA_DIGITS; k++, q /= 10) *--digit = (q % 10) + '0';
+  }
+  return amhbi_trim(res);
+}
+
+
+static amhbi_t *
+amhbi_divexact_blocks (amhbi_t *num1, amhbi_t *num2, uint64_t n)
+{
+  // Each block of l quotient digits is the low l digits of what is left
+  // times the inverse of num2 modulo 10^l; subtracting its multiple of num2
+  // clears them and leaves a carry of about num2's length for the next block
+  uint64_t l = amhbi_size(num2);
+  uint64_t blocks = (n + l - 1) / l;
+  amhbi_t *inv = amhbi_invmod_pow10(num2, l);
+  amhbi_t *one = amhbi_init_int(1);
+  amhbi_t *full = amhbi_mult_pow10(one, l);
+  amhbi_t *res = amhbi_init_empty(blocks * l);
+  amhbi_t *carry = amhbi_init_zero();
+  uint64_t i; for (i = 0; i < blocks; i++) {
+    amhbi_t *chunk = amhbi_slice(num1, i * l, l);
+    amhbi_t *x = amhbi_add(chunk, carry);
+    
+    // A negative x is taken modulo 10^l from its complement
+    amhbi_t *low = amhbi_slice(x, 0, l);
+    if (amhbi_sign(x) && !amhbi_iszero(low)) {
+      amhbi_t *tmp = amhbi_subt(full, low);
+      amhbi_free(1, low);
+      low = tmp;
+    }
+    amhbi_t *q = amhbi_mullo(low, inv, l);
+    amhbi_t *qb = amhbi_mult(q, num2);
+    amhbi_t *t = amhbi_subt(x, qb);
+    amhbi_free(5, carry, chunk, x, low, qb);
+    carry = amhbi_slice(t, l, amhbi_size(t));
+    if (!amhbi_iszero(carry)) carry->sign = amhbi_sign(t);
+    amhbi_free(1, t);
+    
+    // Blocks are laid down from the least significant end
+    char *end = &res->digits[(blocks - i) * l];
+    uint64_t size = amhbi_size(q);
+    memset(end - l, '0', l - size);
+    memcpy(end - size, q->digits, size);
+    amhbi_free(1, q);
+  }
+  amhbi_free(4, inv, one, full, carry);
+  return amhbi_trim(res);
+}
+
+
+amhbi_t *
+amhbi_invmod (amhbi_t *num, amhbi_t *mod)
+{
+  assert(!amhbi_iszero(mod));
+  amhbi_t *m = amhbi_abs(mod);
+  amhbi_t *a = amhbi_rem_calc(num, m);
+  
+  // Word sized moduli run the extended Euclidean algorithm on words
+  if (amhbi_size(m) < 19) {
+    int64_t r0 = amhbi_to_int(a), r1 = amhbi_to_int(m);
+    int64_t s0 = 1, s1 = 0;
+    while (r1) {
+      int64_t q = r0 / r1, t;
+      t = r0 - q * r1; r0 = r1; r1 = t;
+      t = s0 - q * s1; s0 = s1; s1 = t;
+    }
+    amhbi_t *res = NULL;
+    if (r0 == 1) res = amhbi_init_int((s0 < 0) ? s0 + amhbi_to_int(m) : s0);
+    amhbi_free(2, a, m);
+    return res;
+  }
+  
+  // Otherwise the same steps on bigints; s0 * num = r0 modulo m throughout
+  amhbi_t *r0 = a, *r1 = amhbi_init_cpy(m);
+  amhbi_t *s0 = amhbi_init_int(1), *s1 = amhbi_init_zero();
+  while (!amhbi_iszero(r1)) {
+    amhbi_t **qr = amhbi_div(r0, r1);
+    amhbi_t *prod = amhbi_mult(qr[0], s1);
+    amhbi_t *s = amhbi_subt(s0, prod);
+    amhbi_free(4, r0, s0, prod, qr[0]);
+    r0 = r1; r1 = qr[1];
+    s0 = s1; s1 = s;
+    free(qr);
+  }
+  amhbi_t *res = NULL;
+  if (amhbi_size(r0) == 1 && r0->digits[0] == '1') res = amhbi_rem_calc(s0, m);
+  amhbi_free(5, r0, r1, s0, s1, m);
+  return res;
+}
+
+
+/*
+ * Product and remainder trees; each node holds the product of the moduli
+ * below it, so a number is reduced by all of them with a quasi-linear number
+ * of digit operations. Subtrees are split between threads near the root
+ */
+
+void
+amhbi_rem_multi (amhbi_t *num, amhbi_t *moduli[], uint64_t k, amhbi_t *out[])
+{
+  if (!k) return;
+  amhbi_tree_job_t job = {0};
+  job.nums = moduli;
+  job.hi = k;
+  job.threads = amhbi_get_threads();
+  amhbi_tree_build(&job);
+  job.num = num;
+  job.out = out;
+  amhbi_tree_rem(&job);
+  amhbi_tree_free(job.node);
+}
+
+
+amhbi_t *
+amhbi_crt (amhbi_t *residues[], amhbi_t *moduli[], uint64_t k)
+{
+  // Interpolation; each residue is scaled by the inverse of the product of
+  // the other moduli, and the results are combined up the tree. With no
+  // moduli every x qualifies, so the least is 0
+  if (!k) return amhbi_init_zero();
+  amhbi_tree_job_t job = {0};
+  job.nums = moduli;
+  job.vals = residues;
+  job.hi = k;
+  job.threads = amhbi_get_threads();
+  amhbi_tree_build(&job);
+  job.num = amhbi_init_int(1);
+  amhbi_tree_crt(&job);
+  if (!job.res) {
+    amhbi_free(1, job.num);
+    amhbi_tree_free(job.node);
+    return NULL;
+  }
+  amhbi_t *res = amhbi_rem_calc(job.res, job.node->num);
+  amhbi_free(2, job.num, job.res);
+  amhbi_tree_free(job.node);
+  return res;
+}
+
+
+static void
+amhbi_tree_fork (void *(*fn) (void *), amhbi_tree_job_t *left, amhbi_tree_job_t *right, uint64_t threads)
+{
+  // Leftover threads are shared between the two subtrees
+  left->threads = threads / 2;
+  right->threads = threads - left->threads;
+  if (!left->threads) {
+    fn(left);
+    fn(right);
+    return;
+  }
+  pthread_t thread;
+  int ok = pthread_create(&thread, NULL, fn, left);
+  assert(!ok);
+  fn(right);
+  ok = pthread_join(thread, NULL);
+  assert(!ok);
+}
+
+
+static void *
+amhbi_tree_build (void *arg)
+{
+  amhbi_tree_job_t *job = arg;
+  amhbi_tree_t *node = calloc(1, sizeof(amhbi_tree_t));
+  assert(node);
+  node->lo = job->lo;
+  node->hi = job->hi;
+  job->node = node;
+  if (job->hi - job->lo == 1) {
+    assert(!amhbi_iszero(job->nums[job->lo]));
+    node->num = amhbi_abs(job->nums[job->lo]);
+    return NULL;
+  }
+  
+  amhbi_tree_job_t left = *job, right = *job;
+  left.hi = right.lo = job->lo + (job->hi - job->lo) / 2;
+  amhbi_tree_fork(amhbi_tree_build, &left, &right, job->threads);
+  node->left = left.node;
+  node->right = right.node;
+  node->num = amhbi_mult(node->left->num, node->right->num);
+  return NULL;
+}
+
+
+static void *
+amhbi_tree_rem (void *arg)
+{
+  // Leaves take the remainder by the modulus itself, so that its sign
+  // applies; short positive moduli divide a word at a time
+  amhbi_tree_job_t *job = arg;
+  amhbi_tree_t *node = job->node;
+  if (!node->left) {
+    amhbi_t *mod = job->nums[node->lo];
+    if (amhbi_size(mod) <= 18 && !amhbi_sign(mod) && !amhbi_sign(job->num)) {
+      job->out[node->lo] = amhbi_init_uint(amhbi_rem_word(job->num, amhbi_to_uint(mod)));
+    } else {
+      job->out[node->lo] = amhbi_rem_calc(job->num, mod);
+    }
+    return NULL;
+  }
+  
+  amhbi_t *rem = amhbi_rem_calc(job->num, node->num);
+  amhbi_tree_job_t left = *job, right = *job;
+  left.node = node->left;
+  right.node = node->right;
+  left.num = right.num = rem;
+  amhbi_tree_fork(amhbi_tree_rem, &left, &right, job->threads);
+  amhbi_free(1, rem);
+  return NULL;
+}
+
+
+static void *
+amhbi_tree_crt (void *arg)
+{
+  // num is the product of the moduli outside this subtree, reduced by the
+  // product of those within it; res is left NULL when a modulus shares a
+  // factor with the others
+  amhbi_tree_job_t *job = arg;
+  amhbi_tree_t *node = job->node;
+  if (!node->left) {
+    amhbi_t *inv = amhbi_invmod(job->num, node->num);
+    if (!inv) {
+      job->res = NULL;
+      return NULL;
+    }
+    amhbi_t *prod = amhbi_mult(job->vals[node->lo], inv);
+    job->res = amhbi_rem_calc(prod, node->num);
+    amhbi_free(2, inv, prod);
+    return NULL;
+  }
+  
+  amhbi_tree_job_t left = *job, right = *job;
+  left.node = node->left;
+  right.node = node->right;
+  amhbi_t *prod = amhbi_mult(job->num, node->right->num);
+  left.num = amhbi_rem_calc(prod, node->left->num);
+  amhbi_free(1, prod);
+  prod = amhbi_mult(job->num, node->left->num);
+  right.num = amhbi_rem_calc(prod, node->right->num);
+  amhbi_free(1, prod);
+  amhbi_tree_fork(amhbi_tree_crt, &left, &right, job->threads);
+  if (!left.res || !right.res) {
+    amhbi_free(4, left.num, right.num, left.res, right.res);
+    job->res = NULL;
+    return NULL;
+  }
+  
+  // Each side is scaled by the moduli of the other
+  amhbi_t *one = amhbi_mult(left.res, node->right->num);
+  amhbi_t *two = amhbi_mult(right.res, node->left->num);
+  job->res = amhbi_add(one, two);
+  amhbi_free(6, one, two, left.num, right.num, left.res, right.res);
+  return NULL;
+}
+
+
+static void
+amhbi_tree_free (amhbi_tree_t *node)
+{
+  if (node->left) {
+    amhbi_tree_free(node->left);
+    amhbi_tree_free(node->right);
+  }
+  amhbi_free(1, node->num);
+  free(node);
+}
+
+amhbi_t *
+amhbi_half (amhbi_t *num)
+{
+  uint8_t inexact;
+  return amhbi_shift_small(num, 1, 0, &inexact);
+}
+
+
+static amhbi_t *
+amhbi_gcd_calc (amhbi_t *num1, amhbi_t *num2)
+{
+  AMHBI_SPAN(AMHBI_PROBE_GCD, amhbi_size(num1) + amhbi_size(num2));
+  amhbi_t *a = amhbi_abs(num1);
+  amhbi_t *b = amhbi_abs(num2);
+  if (amhbi_cmp(a, b) < 0) {
+    amhbi_t *tmp = a; a = b; b = tmp;
+  }
+  
+  // Half-gcd steps halve long operands; should one make no headway, a
+  // full step does instead
+  while (amhbi_size(b) > AMHBI_GCD_HALF) {
+    uint64_t n = amhbi_size(a);
+    amhbi_hgcd(&a, &b, NULL);
+    if (amhbi_size(a) < n || amhbi_size(b) <= AMHBI_GCD_HALF) continue;
+    amhbi_t *r = amhbi_rem_calc(a, b);
+    amhbi_free(1, a);
+    a = b;
+    b = r;
+  }
+  
+  // Lehmer steps for the rest
+  while (amhbi_size(b) > 18) amhbi_lehmer_step(&a, &b, NULL);
+  
+  // Words finish it
+  if (amhbi_iszero(b)) {
+    amhbi_free(1, b);
+    return a;
+  }
+  if (amhbi_size(a) > 18) {
+    amhbi_t *r = amhbi_rem_calc(a, b);
+    amhbi_free(1, a);
+    a = r;
+  }
+  uint64_t x = amhbi_to_uint(a), y = amhbi_to_uint(b);
+  while (y) {
+    uint64_t t = x % y;
+    x = y;
+    y = t;
+  }
+  amhbi_free(2, a, b);
+  return amhbi_init_uint(x);
+}
+
+
+static amhbi_t *
+amhbi_gcd_comb (amhbi_t *a, amhbi_t *b, int64_t A, int64_t B)
+{
+  // One pass over base 10^8 limbs; the cofactors are below 10^18, so each
+  // column and its signed carry fit 128 bits, and the result fits in a
+  uint64_t n = (amhbi_size(a) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  uint64_t nb = (amhbi_size(b) + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  amhbi_t *res = amhbi_init_empty(n * AMHBI_SSA_DIGITS);
+  char *digit = &res->digits[n * AMHBI_SSA_DIGITS];
+  __int128 carry = 0;
+  uint64_t i; for (i = 0; i < n; i++) {
+    __int128 cur = (__int128)A * amhbi_ssa_limb(a, i) + carry;
+    if (i < nb) cur += (__int128)B * amhbi_ssa_limb(b, i);
+    int64_t limb = cur % AMHBI_SSA_BASE;
+    if (limb < 0) limb += AMHBI_SSA_BASE;
+    carry = (cur - limb) / AMHBI_SSA_BASE;
+    uint8_t k; for (k = 0; k < AMHBI_SSA_DIGITS; k++, limb /= 10) *--digit = (limb % 10) + '0';
+  }
+  assert(!carry);
+  return amhbi_trim(res);
+}
+
+
+static void
+amhbi_lehmer_step (amhbi_t **a, amhbi_t **b, amhbi_t *m[4])
+{
+  // Euclid's steps are run on the top eighteen digits of a and the same
+  // digits of b for as long as the quotients are certain, then applied to
+  // the whole of both at once
+  int64_t A = 1, B = 0, C = 0, D = 1;
+  if (amhbi_size(*a) > 18) {
+    uint64_t k = amhbi_size(*a) - 18;
+    int64_t x = 0, y = 0;
+    uint64_t i; for (i = 0; i < 18; i++) x = x * 10 + ((*a)->digits[i] - '0');
+    for (i = 0; i + k < amhbi_size(*b); i++) y = y * 10 + ((*b)->digits[i] - '0');
+    while (y + C > 0 && y + D > 0) {
+      int64_t q = (x + A) / (y + C);
+      if (q != (x + B) / (y + D)) break;
+      int64_t t = A - q * C; A = C; C = t;
+      t = B - q * D; B = D; D = t;
+      t = x - q * y; x = y; y = t;
+    }
+  }
+  
+  // No certain quotient; a single full step, (a, b) to (b, a - q b)
+  if (!B) {
+    amhbi_t **qr = amhbi_div(*a, *b);
+    amhbi_free(1, *a);
+    *a = *b;
+    *b = qr[1];
+    if (m) {
+      amhbi_t *t2 = amhbi_mult(qr[0], m[2]);
+      amhbi_t *t3 = amhbi_mult(qr[0], m[3]);
+      amhbi_t *n2 = amhbi_subt(m[0], t2);
+      amhbi_t *n3 = amhbi_subt(m[1], t3);
+      amhbi_free(4, m[0], m[1], t2, t3);
+      m[0] = m[2];
+      m[1] = m[3];
+      m[2] = n2;
+      m[3] = n3;
+    }
+    amhbi_free(1, qr[0]);
+    free(qr);
+    return;
+  }
+  amhbi_t *na = amhbi_gcd_comb(*a, *b, A, B);
+  amhbi_t *nb = amhbi_gcd_comb(*a, *b, C, D);
+  amhbi_free(2, *a, *b);
+  *a = na;
+  *b = nb;
+  if (m) {
+    amhbi_t *n[4] = {amhbi_init_int(A), amhbi_init_int(B), amhbi_init_int(C), amhbi_init_int(D)};
+    amhbi_hgcd_mul(m, n);
+    amhbi_free(4, n[0], n[1], n[2], n[3]);
+  }
+}
+
+
+static void
+amhbi_hgcd (amhbi_t **a, amhbi_t **b, amhbi_t *m[4])
+{
+  if (m) {
+    m[0] = amhbi_init_int(1);
+    m[1] = amhbi_init_zero();
+    m[2] = amhbi_init_zero();
+    m[3] = amhbi_init_int(1);
+  }
+  uint64_t n = amhbi_size(*a);
+  uint64_t s = n / 2 + 1;
+  if (amhbi_size(*b) <= s) return;
+  
+  // Short operands take Lehmer steps until b is down to s digits
+  if (n <= AMHBI_HGCD_BASECASE) {
+    while (amhbi_size(*b) > s) amhbi_lehmer_step(a, b, m);
+    return;
+  }
+  
+  // Cofactors of the top n - s digits take b down to about 3 n / 4 digits
+  amhbi_t *h[4];
+  amhbi_t *ha = amhbi_slice(*a, s, n);
+  amhbi_t *hb = amhbi_slice(*b, s, n);
+  amhbi_hgcd(&ha, &hb, h);
+  amhbi_free(2, ha, hb);
+  amhbi_hgcd_apply(a, b, h);
+  if (m) amhbi_hgcd_mul(m, h);
+  amhbi_free(4, h[0], h[1], h[2], h[3]);
+  if (amhbi_size(*b) <= s) return;
+  
+  // One step between the halves, then cofactors of the top 2 (n2 - s)
+  // digits take b down to about s digits; a, which never grows, is checked
+  // so that the heads stay shorter than n
+  amhbi_lehmer_step(a, b, m);
+  uint64_t n2 = amhbi_size(*a);
+  if (amhbi_size(*b) <= s || n2 >= n) return;
+  ha = amhbi_slice(*a, 2 * s - n2, n2);
+  hb = amhbi_slice(*b, 2 * s - n2, n2);
+  amhbi_hgcd(&ha, &hb, h);
+  amhbi_free(2, ha, hb);
+  amhbi_hgcd_apply(a, b, h);
+  if (m) amhbi_hgcd_mul(m, h);
+  amhbi_free(4, h[0], h[1], h[2], h[3]);
+}
+
+
+static void
+amhbi_hgcd_apply (amhbi_t **a, amhbi_t **b, amhbi_t *m[4])
+{
+  amhbi_t *v[2];
+  uint8_t row; for (row = 0; row < 2; row++) {
+    amhbi_t *x = amhbi_mult(m[2 * row], *a);
+    amhbi_t *y = amhbi_mult(m[2 * row + 1], *b);
+    v[row] = amhbi_add(x, y);
+    amhbi_free(2, x, y);
+  }
+  amhbi_free(2, *a, *b);
+  
+  // Cofactors from the heads can be a step off near the end; any m of
+  // determinant -1 or 1 keeps the gcd, so signs and order are set right by
+  // negating and swapping its rows
+  for (row = 0; row < 2; row++) {
+    if (!amhbi_sign(v[row])) continue;
+    v[row]->sign = 0;
+    uint8_t j; for (j = 0; j < 2; j++) {
+      if (!amhbi_iszero(m[2 * row + j])) m[2 * row + j]->sign ^= 1;
+    }
+  }
+  if (amhbi_cmp(v[0], v[1]) < 0) {
+    amhbi_t *t = v[0]; v[0] = v[1]; v[1] = t;
+    t = m[0]; m[0] = m[2]; m[2] = t;
+    t = m[1]; m[1] = m[3]; m[3] = t;
+  }
+  *a = v[0];
+  *b = v[1];
+}
+
+
+static void
+amhbi_hgcd_mul (amhbi_t *m[4], amhbi_t *n[4])
+{
+  amhbi_t *r[4];
+  uint8_t i; for (i = 0; i < 4; i++) {
+    amhbi_t *x = amhbi_mult(n[i & 2], m[i & 1]);
+    amhbi_t *y = amhbi_mult(n[(i & 2) + 1], m[(i & 1) + 2]);
+    r[i] = amhbi_add(x, y);
+    amhbi_free(2, x, y);
+  }
+  for (i = 0; i < 4; i++) {
+    amhbi_free(1, m[i]);
+    m[i] = r[i];
+  }
+}
+
+
+static uint64_t
+amhbi_rem_word (amhbi_t *num, uint64_t m)
+{
+  assert(m);
+  
+  // Horner's rule over chunks of nine digits; rem * 10^9 fits a word for
+  // moduli below 2^32, and needs a double word above
+  uint64_t rem = 0;
+  uint64_t i = 0;
+  while (i < amhbi_size(num)) {
+    uint64_t chunk = 0;
+    uint64_t scale = 1;
+    uint64_t end = (i + 9 < amhbi_size(num)) ? i + 9 : amhbi_size(num);
+    for (; i < end; i++) {
+      chunk = chunk * 10 + (num->digits[i] - '0');
+      scale *= 10;
+    }
+    if (m >> 32) rem = ((unsigned __int128)rem * scale + chunk) % m;
+    else rem = (rem * scale + chunk) % m;
+  }
+  return rem;
+}
+
+
+static int8_t
+amhbi_root_cmp_word (uint64_t r, uint64_t k, uint64_t val)
+{
+  uint64_t acc = 1;
+  uint64_t i; for (i = 0; i < k; i++) {
+    if (r && acc > val / r) return 1;
+    acc *= r;
+  }
+  if (acc < val) return -1;
+  return (acc > val) ? 1 : 0;
+}
+
+
+static uint8_t
+amhbi_isprime_word (uint64_t n)
+{
+  // Miller-Rabin with the primes up to 37 as bases is exact for every word
+  static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  if (n < 2) return 0;
+  uint64_t i; for (i = 0; i < 12; i++) {
+    if (n % bases[i] == 0) return (n == bases[i]) ? 1 : 0;
+  }
+  uint64_t d = n - 1;
+  uint64_t s = 0;
+  while (d % 2 == 0) {d /= 2; s++;}
+  for (i = 0; i < 12; i++) {
+    uint64_t x = amhbi_powm_word(bases[i], d, n);
+    if (x == 1 || x == n - 1) continue;
+    uint64_t r; for (r = 1; r < s && x != n - 1; r++) x = (unsigned __int128)x * x % n;
+    if (x != n - 1) return 0;
+  }
+  return 1;
+}
+
+
+static uint64_t
+amhbi_powm_word (uint64_t b, uint64_t e, uint64_t m)
+{
+  uint64_t res = 1 % m;
+  b %= m;
+  while (e) {
+    if (e & 1) res = (unsigned __int128)res * b % m;
+    b = (unsigned __int128)b * b % m;
+    e >>= 1;
+  }
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_root_newton (amhbi_t *num, uint64_t k)
+{
+  AMHBI_SPAN(AMHBI_PROBE_ROOT, amhbi_size(num));
+  uint64_t size = amhbi_size(num);
+  
+  // Base case: anything below 10^18 has a word sized root
+  if (size <= 18) {
+    uint64_t val = amhbi_to_uint(num);
+    uint64_t r = (uint64_t)powl((long double)val, 1.0L / k);
+    while (r && amhbi_root_cmp_word(r, k, val) > 0) r--;
+    while (amhbi_root_cmp_word(r + 1, k, val) <= 0) r++;
+    return amhbi_init_uint(r);
+  }
+  
+  // Long square roots come from the recursion on quarters
+  if (k == 2 && size > AMHBI_SQRT_BASECASE) {
+    amhbi_t *rem;
+    amhbi_t *res = amhbi_sqrtrem_rec(num, &rem);
+    amhbi_free(1, rem);
+    return res;
+  }
+  
+  // Roots of less than two digits are found by bisection
+  uint64_t j = size / (2 * k);
+  if (!j) {
+    amhbi_t *kk = amhbi_init_uint(k);
+    uint64_t lo = 1, hi = 99;
+    while (lo < hi) {
+      uint64_t mid = (lo + hi + 1) / 2;
+      amhbi_t *r = amhbi_init_uint(mid);
+      amhbi_t *pw = amhbi_pow_calc(r, kk);
+      if (amhbi_cmp(pw, num) > 0) hi = mid - 1; else lo = mid;
+      amhbi_free(2, r, pw);
+    }
+    amhbi_free(1, kk);
+    return amhbi_init_uint(lo);
+  }
+  
+  // Start from the root of the leading half of the digits; since
+  // num < (top + 1) * 10^(k * j), (root(top) + 1) * 10^j >= root(num)
+  amhbi_t **split = amhbi_split(num, size - k * j);
+  amhbi_t *est = amhbi_root_newton(split[0], k);
+  amhbi_free(2, split[0], split[1]); free(split);
+  amhbi_t *x = amhbi_mult_pow10_to(amhbi_incr(est), j);
+  
+  // Newton steps from above never undershoot the root. From that estimate
+  // one step leaves x at most a few units high, which a few powers settle
+  // for less than the division of a confirming step
+  amhbi_t *km1 = amhbi_init_uint(k - 1);
+  amhbi_t *kk = amhbi_init_uint(k);
+  while (1) {
+    amhbi_t *xp = (k == 2) ? amhbi_init_cpy(x) : amhbi_pow_calc(x, km1);
+    amhbi_t *q = amhbi_quo_calc(num, xp);
+    amhbi_t *t = amhbi_mult(x, km1);
+    amhbi_t *s = amhbi_add(t, q);
+    amhbi_t *y = (k == 2) ? amhbi_half(s) : amhbi_quo_calc(s, kk);
+    amhbi_free(4, xp, q, t, s);
+    if (amhbi_cmp(y, x) >= 0) {
+      amhbi_free(1, y);
+      break;
+    }
+    amhbi_free(1, x);
+    x = y;
+    
+    uint8_t settled = 0;
+    uint64_t i; for (i = 0; i < 3 && !settled; i++) {
+      amhbi_t *pw = amhbi_pow_calc(x, kk);
+      if (amhbi_cmp(pw, num) <= 0) settled = 1;
+      else amhbi_decr(x);
+      amhbi_free(1, pw);
+    }
+    if (settled) break;
+  }
+  amhbi_free(2, km1, kk);
+  return x;
+}
+
+
+static amhbi_t *
+amhbi_sqrtrem_rec (amhbi_t *num, amhbi_t **rem)
+{
+  AMHBI_SPAN(AMHBI_PROBE_ROOT, amhbi_size(num));
+  uint64_t size = amhbi_size(num);
+  if (size <= AMHBI_SQRT_BASECASE) {
+    amhbi_t *res = amhbi_root_newton(num, 2);
+    amhbi_t *sq = amhbi_mult(res, res);
+    *rem = amhbi_subt(num, sq);
+    amhbi_free(1, sq);
+    return res;
+  }
+  
+  // Karatsuba square root: with num = top 10^(2l) + a1 10^l + a0 and
+  // top = s'^2 + r', the next l digits of the root are the quotient of
+  // r' 10^l + a1 by 2 s'. The top part has more than l digits, so s' is
+  // large enough that this is at most one too high
+  uint64_t l = (size - 1) / 4;
+  amhbi_t *top = amhbi_slice(num, 2 * l, size - 2 * l);
+  amhbi_t *a1 = amhbi_slice(num, l, l);
+  amhbi_t *a0 = amhbi_slice(num, 0, l);
+  amhbi_t *r1;
+  amhbi_t *s1 = amhbi_sqrtrem_rec(top, &r1);
+  amhbi_t *shifted = amhbi_mult_pow10_to(r1, l);
+  amhbi_t *x = amhbi_add(shifted, a1);
+  amhbi_t *twice = amhbi_add(s1, s1);
+  amhbi_t **qu = amhbi_div(x, twice);
+  amhbi_free(4, top, a1, shifted, x);
+  
+  // root = s' 10^l + q, rem = u 10^l + a0 - q^2
+  amhbi_t *high = amhbi_mult_pow10_to(s1, l);
+  amhbi_t *res = amhbi_add(high, qu[0]);
+  amhbi_t *sq = amhbi_mult(qu[0], qu[0]);
+  amhbi_t *low = amhbi_add(amhbi_mult_pow10_to(qu[1], l), a0);
+  amhbi_t *r = amhbi_subt(low, sq);
+  amhbi_free(7, high, twice, qu[0], qu[1], low, sq, a0); free(qu);
+  
+  // A root one too high leaves rem short by 2 root - 1
+  if (amhbi_sign(r)) {
+    amhbi_t *fix = amhbi_add(r, res);
+    amhbi_free(1, r);
+    amhbi_decr(res);
+    r = amhbi_add(fix, res);
+    amhbi_free(1, fix);
+  }
+  *rem = r;
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_sqrt_calc (amhbi_t *num)
+{
+  assert(!amhbi_sign(num));
+  return amhbi_root_newton(num, 2);
+}
+
+
+amhbi_t **
+amhbi_sqrtrem (amhbi_t *num)
+{
+  assert(!amhbi_sign(num));
+  
+  // Create array of results (root, remainder)
+  amhbi_t **res = calloc(2, sizeof(amhbi_t *));
+  assert(res);
+  
+  res[0] = amhbi_sqrtrem_rec(num, &res[1]);
+  return res;
+}
+
+
+amhbi_t *
+amhbi_root_ui (amhbi_t *num, uint64_t k)
+{
+  assert(k > 0);
+  assert(!amhbi_sign(num) || k % 2);
+  if (k == 1) return amhbi_init_cpy(num);
+  
+  // Odd roots of negative numbers are the negated roots of their magnitude
+  amhbi_t *mag = amhbi_abs(num);
+  amhbi_t *res = amhbi_root_newton(mag, k);
+  amhbi_free(1, mag);
+  if (amhbi_sign(num) && !amhbi_iszero(res)) res->sign = 1;
+  return res;
+}
+
+
+uint8_t
+amhbi_issquare (amhbi_t *num)
+{
+  if (amhbi_sign(num)) return 0;
+  
+  // Squares are quadratic residues modulo 100, 9, 7, 11, 13, 17, 19, 23
+  // and 29; together these reject all but about 1 in 3000 non-squares
+  static const uint32_t mods[] = {100, 9, 7, 11, 13, 17, 19, 23, 29};
+  uint64_t size = amhbi_size(num);
+  uint64_t low = num->digits[size - 1] - '0';
+  if (size > 1) low += (num->digits[size - 2] - '0') * 10;
+  uint64_t rem = amhbi_rem_word(num, 1940907969);
+  uint64_t i; for (i = 0; i < sizeof(mods) / sizeof(mods[0]); i++) {
+    uint64_t r = (i) ? rem % mods[i] : low;
+    uint64_t x; for (x = 0; x < mods[i]; x++) {
+      if ((x * x) % mods[i] == r) break;
+    }
+    if (x == mods[i]) return 0;
+  }
+  
+  // Only survivors pay for the root
+  amhbi_t **res = amhbi_sqrtrem(num);
+  uint8_t square = amhbi_iszero(res[1]);
+  amhbi_free(2, res[0], res[1]); free(res);
+  return square;
+}
+
+
+uint8_t
+amhbi_ispower (amhbi_t *num)
+{
+  if (amhbi_iszero(num) || amhbi_isunit(num)) return 1;
+  if (!amhbi_sign(num) && amhbi_issquare(num)) return 1;
+  amhbi_t *mag = amhbi_abs(num);
+  
+  // Only odd prime exponents are left, and they are bounded by log2(num)
+  uint64_t bits = (uint64_t)(amhbi_size(num) * 3.3219280948873623) + 1;
+  uint64_t limit = 64 * bits + 4096;
+  if (limit > AMHBI_POWER_SIEVE) limit = AMHBI_POWER_SIEVE;
+  uint8_t *composite = calloc(limit, 1);
+  assert(composite);
+  uint64_t i; for (i = 2; i * i < limit; i++) {
+    if (composite[i]) continue;
+    uint64_t j; for (j = i * i; j < limit; j += i) composite[j] = 1;
+  }
+  
+  // A p-th power is a p-th power residue modulo every prime q = 1 (mod p),
+  // which a non-power only is with probability 1/p; each exponent gets
+  // enough such q to let through about one non-power in 2^20
+  uint64_t cap = 1024, nexp = 0, nq = 0;
+  uint64_t *exps = malloc(cap * sizeof(uint64_t));
+  uint64_t *first = malloc((cap + 1) * sizeof(uint64_t));
+  uint64_t qcap = 4 * cap;
+  uint64_t *qs = malloc(qcap * sizeof(uint64_t));
+  assert(exps && first && qs);
+  uint64_t p; for (p = 3; p <= bits; p += 2) {
+    if ((p < limit) ? composite[p] : !amhbi_isprime_word(p)) continue;
+    if (nexp == cap) {
+      cap *= 2;
+      exps = realloc(exps, cap * sizeof(uint64_t));
+      first = realloc(first, (cap + 1) * sizeof(uint64_t));
+      assert(exps && first);
+    }
+    exps[nexp] = p;
+    first[nexp++] = nq;
+    uint64_t lg = 63 - __builtin_clzll(p);
+    uint64_t want = (20 + lg - 1) / lg;
+    if (want < 2) want = 2;
+    uint64_t found = 0;
+    uint64_t q; for (q = 2 * p + 1; found < want; q += 2 * p) {
+      if ((q < limit) ? composite[q] : !amhbi_isprime_word(q)) continue;
+      if (nq == qcap) {
+        qcap *= 2;
+        qs = realloc(qs, qcap * sizeof(uint64_t));
+        assert(qs);
+      }
+      qs[nq++] = q;
+      found++;
+    }
+  }
+  first[nexp] = nq;
+  free(composite);
+  
+  // The q are packed into words below 10^18, so one remainder tree reduces
+  // num by all of them
+  amhbi_t **packs = malloc((nq + 1) * sizeof(amhbi_t *));
+  uint64_t *packof = malloc((nq + 1) * sizeof(uint64_t));
+  assert(packs && packof);
+  uint64_t npack = 0, word = 1;
+  for (i = 0; i < nq; i++) {
+    if (word > 999999999999999999ULL / qs[i]) {
+      packs[npack++] = amhbi_init_uint(word);
+      word = 1;
+    }
+    word *= qs[i];
+    packof[i] = npack;
+  }
+  if (nq) packs[npack++] = amhbi_init_uint(word);
+  amhbi_t **rems = malloc((npack + 1) * sizeof(amhbi_t *));
+  assert(rems);
+  amhbi_rem_multi(mag, packs, npack, rems);
+  uint64_t *words = malloc((npack + 1) * sizeof(uint64_t));
+  assert(words);
+  for (i = 0; i < npack; i++) words[i] = amhbi_to_uint(rems[i]);
+  
+  // Only exponents that pass every residue test pay for a root
+  uint8_t power = 0;
+  for (i = 0; i < nexp && !power; i++) {
+    p = exps[i];
+    uint8_t residue = 1;
+    uint64_t j; for (j = first[i]; j < first[i + 1] && residue; j++) {
+      uint64_t r = words[packof[j]] % qs[j];
+      if (r && amhbi_powm_word(r, (qs[j] - 1) / p, qs[j]) != 1) residue = 0;
+    }
+    if (!residue) continue;
+    amhbi_t *root = amhbi_root_newton(mag, p);
+    amhbi_t *pp = amhbi_init_uint(p);
+    amhbi_t *pw = amhbi_pow_calc(root, pp);
+    power = (amhbi_cmp(pw, mag) == 0) ? 1 : 0;
+    amhbi_free(3, root, pp, pw);
+  }
+  
+  for (i = 0; i < npack; i++) amhbi_free(2, packs[i], rems[i]);
+  free(packs); free(rems); free(words); free(packof);
+  free(exps); free(first); free(qs);
+  amhbi_free(1, mag);
+  return power;
+}
+
+
+/*
+ * Modular powers; moduli coprime to 10 are worked in Montgomery form with
+ * R = 10^n, where reduction is two short products and no division
+ */
+
+static amhbi_t *
+amhbi_powm_calc (amhbi_t *num, amhbi_t *p, amhbi_t *mod)
+{
+  AMHBI_SPAN(AMHBI_PROBE_POWM, amhbi_size(mod));
+  // Negative powers are powers of the inverse
+  assert(!amhbi_iszero(mod));
+  amhbi_t *base = (amhbi_sign(p)) ? amhbi_invmod(num, mod) : amhbi_rem_calc(num, mod);
+  assert(base);
+  amhbi_mont_t *ctx = amhbi_mont_init(mod);
+  amhbi_t *form = amhbi_mont_to(ctx, base);
+  amhbi_t *exp = amhbi_abs(p);
+  amhbi_t *pw = amhbi_mont_pow(ctx, form, exp);
+  amhbi_t *res = amhbi_mont_from(ctx, pw);
+  amhbi_free(4, base, form, exp, pw);
+  amhbi_mont_free(ctx);
+  return res;
+}
+
+
+static amhbi_mont_t *
+amhbi_mont_init (amhbi_t *mod)
+{
+  amhbi_mont_t *ctx = calloc(1, sizeof(amhbi_mont_t));
+  assert(ctx);
+  ctx->mod = amhbi_abs(mod);
+  amhbi_t *one = amhbi_init_int(1);
+  uint8_t last = ctx->mod->digits[amhbi_size(ctx->mod) - 1] - '0';
+  if (last % 2 == 0 || last == 5 || amhbi_isunit(ctx->mod)) {
+    ctx->one = amhbi_rem_calc(one, ctx->mod);
+    amhbi_free(1, one);
+    return ctx;
+  }
+  
+  // Reduction needs -1 / mod modulo R, and 1 is represented by R mod mod
+  ctx->n = amhbi_size(ctx->mod);
+  amhbi_t *r = amhbi_mult_pow10(one, ctx->n);
+  amhbi_t *inv = amhbi_invmod_pow10(ctx->mod, ctx->n);
+  ctx->inv = amhbi_subt(r, inv);
+  ctx->one = amhbi_rem_calc(r, ctx->mod);
+  amhbi_free(3, one, r, inv);
+  return ctx;
+}
+
+
+static amhbi_t *
+amhbi_mont_redc (amhbi_mont_t *ctx, amhbi_t *num)
+{
+  // q makes num + q * mod a multiple of R, so the low halves of the two
+  // sum to R exactly unless both are zero, and only high halves are needed
+  amhbi_t *lo = amhbi_slice(num, 0, ctx->n);
+  amhbi_t *hi = amhbi_slice(num, ctx->n, UINT64_MAX);
+  amhbi_t *q = amhbi_mullo(lo, ctx->inv, ctx->n);
+  amhbi_t *qm = amhbi_mulhi(q, ctx->mod, ctx->n);
+  amhbi_t *res = amhbi_add(hi, qm);
+  if (!amhbi_iszero(lo)) amhbi_incr(res);
+  amhbi_free(4, lo, hi, q, qm);
+  
+  // num below mod * R leaves res below 2 * mod
+  if (amhbi_cmp(res, ctx->mod) >= 0) {
+    amhbi_t *tmp = amhbi_subt(res, ctx->mod);
+    amhbi_free(1, res);
+    res = tmp;
+  }
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_mont_mul (amhbi_mont_t *ctx, amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_t *prod = amhbi_mult(num1, num2);
+  amhbi_t *res = (ctx->n) ? amhbi_mont_redc(ctx, prod) : amhbi_rem_calc(prod, ctx->mod);
+  amhbi_free(1, prod);
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_mont_add (amhbi_mont_t *ctx, amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_t *res = amhbi_add(num1, num2);
+  if (amhbi_cmp(res, ctx->mod) >= 0) {
+    amhbi_t *tmp = amhbi_subt(res, ctx->mod);
+    amhbi_free(1, res);
+    res = tmp;
+  }
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_mont_sub (amhbi_mont_t *ctx, amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_t *res = amhbi_subt(num1, num2);
+  if (amhbi_sign(res)) {
+    amhbi_t *tmp = amhbi_add(res, ctx->mod);
+    amhbi_free(1, res);
+    res = tmp;
+  }
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_mont_half (amhbi_mont_t *ctx, amhbi_t *num)
+{
+  // Odd values are halved as num + mod, which is even for an odd modulus
+  if (amhbi_iseven(num)) return amhbi_half(num);
+  amhbi_t *tmp = amhbi_add(num, ctx->mod);
+  amhbi_t *res = amhbi_half(tmp);
+  amhbi_free(1, tmp);
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_mont_to (amhbi_mont_t *ctx, amhbi_t *num)
+{
+  amhbi_t *res = amhbi_rem_calc(num, ctx->mod);
+  if (!ctx->n) return res;
+  amhbi_t *tmp = amhbi_mult_pow10(res, ctx->n);
+  amhbi_free(1, res);
+  res = amhbi_rem_calc(tmp, ctx->mod);
+  amhbi_free(1, tmp);
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_mont_from (amhbi_mont_t *ctx, amhbi_t *num)
+{
+  return (ctx->n) ? amhbi_mont_redc(ctx, num) : amhbi_init_cpy(num);
+}
+
+
+static amhbi_t *
+amhbi_mont_pow (amhbi_mont_t *ctx, amhbi_t *num, amhbi_t *p)
+{
+  // One decimal digit of the power at a time, from a table of num^0 to num^9
+  amhbi_t *table[10];
+  table[0] = amhbi_init_cpy(ctx->one);
+  table[1] = amhbi_init_cpy(num);
+  uint8_t d; for (d = 2; d < 10; d++) table[d] = amhbi_mont_mul(ctx, table[d - 1], num);
+  amhbi_t *res = amhbi_init_cpy(table[p->digits[0] - '0']);
+  uint64_t i; for (i = 1; i < amhbi_size(p); i++) {
+    // res^10 as ((res^2)^2 * res)^2
+    amhbi_t *sq = amhbi_mont_mul(ctx, res, res);
+    amhbi_t *fourth = amhbi_mont_mul(ctx, sq, sq);
+    amhbi_t *fifth = amhbi_mont_mul(ctx, fourth, res);
+    amhbi_free(3, res, sq, fourth);
+    res = amhbi_mont_mul(ctx, fifth, fifth);
+    amhbi_free(1, fifth);
+    d = p->digits[i] - '0';
+    if (d) {
+      amhbi_t *tmp = amhbi_mont_mul(ctx, res, table[d]);
+      amhbi_free(1, res);
+      res = tmp;
+    }
+  }
+  for (d = 0; d < 10; d++) amhbi_free(1, table[d]);
+  return res;
+}
+
+
+static void
+amhbi_mont_free (amhbi_mont_t *ctx)
+{
+  amhbi_free(2, ctx->mod, ctx->one);
+  if (ctx->inv) amhbi_free(1, ctx->inv);
+  free(ctx);
+}
+
+
+static amhbi_t *
+amhbi_invmod_pow10 (amhbi_t *num, uint64_t n)
+{
+  // Hensel lifting; x = 1 / num modulo 10^k leaves num x = 1 + e 10^k, and
+  // x - x e 10^k is the inverse modulo 10^2k, so only e x needs a product
+  static const uint8_t inv[10] = {0, 1, 0, 7, 0, 0, 0, 3, 0, 9};
+  uint8_t last = num->digits[amhbi_size(num) - 1] - '0';
+  assert(inv[last]);
+  amhbi_t *res = amhbi_init_int(inv[last]);
+  uint64_t k = 1;
+  while (k < n) {
+    uint64_t next = (2 * k < n) ? 2 * k : n;
+    amhbi_t *low = amhbi_slice(num, 0, next);
+    amhbi_t *prod = amhbi_mullo(low, res, next);
+    amhbi_t *err = amhbi_slice(prod, k, next - k);
+    amhbi_t *corr = amhbi_mullo(res, err, next - k);
+    amhbi_free(3, low, prod, err);
+    
+    // Subtracting the correction modulo 10^(next - k) means adding its
+    // complement above the k digits already settled
+    if (!amhbi_iszero(corr)) {
+      amhbi_t *one = amhbi_init_int(1);
+      amhbi_t *top = amhbi_mult_pow10(one, next - k);
+      amhbi_t *comp = amhbi_subt(top, corr);
+      amhbi_mult_pow10_to(comp, k);
+      amhbi_t *tmp = amhbi_add(res, comp);
+      amhbi_free(5, res, one, top, comp, corr);
+      res = tmp;
+    } else {
+      amhbi_free(1, corr);
+    }
+    k = next;
+  }
+  return res;
+}
+
+
+/*
+ * Primality; candidates are trial divided by a table of small primes a few
+ * at a time, then put through Baillie-PSW and any further Miller-Rabin
+ * rounds in Montgomery form
+ */
+
+static uint32_t amhbi_primes[AMHBI_PRIME_COUNT];
+static pthread_once_t amhbi_primes_once = PTHREAD_ONCE_INIT;
+
+
+uint8_t
+amhbi_is_probab_prime (amhbi_t *num, uint64_t reps)
+{
+  // Words are settled exactly
+  if (amhbi_size(num) < 19) {
+    int64_t val = amhbi_to_int(num);
+    return amhbi_isprime_word((val < 0) ? -val : val) ? 2 : 0;
+  }
+  amhbi_t *n = amhbi_abs(num);
+  pthread_once(&amhbi_primes_once, amhbi_primes_init);
+  uint32_t *rems = malloc(AMHBI_PRIME_COUNT * sizeof(uint32_t));
+  assert(rems);
+  amhbi_rem_primes(n, rems);
+  uint8_t prime = 1;
+  uint64_t i; for (i = 0; i < AMHBI_PRIME_COUNT && prime; i++) prime = (rems[i] != 0);
+  free(rems);
+  if (!prime) {
+    amhbi_free(1, n);
+    return 0;
+  }
+  
+  // n - 1 = d * 2^s with d odd
+  amhbi_mont_t *ctx = amhbi_mont_init(n);
+  amhbi_t *d = amhbi_init_cpy(n);
+  amhbi_decr(d);
+  uint64_t s = 0;
+  while (amhbi_iseven(d)) {
+    amhbi_t *tmp = amhbi_half(d);
+    amhbi_free(1, d);
+    d = tmp;
+    s++;
+  }
+  
+  // Baillie-PSW is a base 2 strong probable prime test followed by a strong
+  // Lucas test; further rounds take random bases from 2 to n - 2, drawn
+  // from a fixed seed so that results are reproducible
+  amhbi_t *base = amhbi_init_int(2);
+  prime = amhbi_mr(ctx, d, s, base) && amhbi_lucas(ctx);
+  amhbi_free(1, base);
+  amhbi_rand_t rand = {0, 0};
+  amhbi_t *range = amhbi_init_int(3);
+  amhbi_t *span = amhbi_subt(n, range);
+  for (i = 0; i < reps && prime; i++) {
+    amhbi_t *draw = amhbi_urandomm(&rand, span);
+    base = amhbi_incr(amhbi_incr(draw));
+    prime = amhbi_mr(ctx, d, s, base);
+    amhbi_free(1, base);
+  }
+  amhbi_free(4, n, d, range, span);
+  amhbi_mont_free(ctx);
+  return prime;
+}
+
+
+static amhbi_t *
+amhbi_nextprime_calc (amhbi_t *num)
+{
+  // Word sized results are found by testing each number in turn
+  if (amhbi_sign(num) || amhbi_size(num) < 18) {
+    uint64_t n = (amhbi_sign(num)) ? 0 : amhbi_to_uint(num);
+    for (n++; !amhbi_isprime_word(n); n++);
+    return amhbi_init_uint(n);
+  }
+  
+  // Windows are wide enough to hold a prime nearly always, since primes
+  // near num are about 2.3 times its number of digits apart
+  amhbi_t *base = amhbi_init_cpy(num);
+  amhbi_incr(base);
+  pthread_once(&amhbi_primes_once, amhbi_primes_init);
+  uint32_t *rems = malloc(AMHBI_PRIME_COUNT * sizeof(uint32_t));
+  assert(rems);
+  amhbi_rem_primes(base, rems);
+  uint64_t width = AMHBI_SIEVE_WINDOW;
+  while (width < 64 * amhbi_size(num)) width *= 2;
+  uint8_t *composite = malloc(width);
+  uint64_t *offsets = malloc(width * sizeof(uint64_t));
+  uint64_t count = (amhbi_size(num) < AMHBI_SIEVE_PARALLEL) ? 1 : amhbi_get_threads();
+  amhbi_sieve_job_t *jobs = calloc(count, sizeof(amhbi_sieve_job_t));
+  assert(composite && offsets && jobs);
+  
+  // One sieve per window; threads take its survivors in turn, and each stops
+  // at the first of its own past the lowest prime found so far, so every
+  // candidate below that one has been tested when they are done
+  amhbi_t *res = NULL;
+  uint64_t offset; for (offset = 0; !res; offset += width) {
+    memset(composite, 0, width);
+    uint64_t i; for (i = 0; i < AMHBI_PRIME_COUNT; i++) {
+      uint64_t p = amhbi_primes[i];
+      uint64_t j = (p - (rems[i] + offset % p) % p) % p;
+      for (; j < width; j += p) composite[j] = 1;
+    }
+    uint64_t survivors = 0;
+    for (i = 0; i < width; i++) {
+      if (!composite[i]) offsets[survivors++] = offset + i;
+    }
+    
+    uint64_t best = survivors;
+    for (i = 0; i < count; i++) {
+      jobs[i].base = base;
+      jobs[i].offsets = offsets;
+      jobs[i].count = survivors;
+      jobs[i].first = i;
+      jobs[i].stride = count;
+      jobs[i].best = &best;
+      jobs[i].res = NULL;
+    }
+    for (i = 1; i < count; i++) {
+      int ok = pthread_create(&jobs[i].thread, NULL, amhbi_sieve_worker, &jobs[i]);
+      assert(!ok);
+    }
+    amhbi_sieve_worker(&jobs[0]);
+    for (i = 1; i < count; i++) {
+      int ok = pthread_join(jobs[i].thread, NULL);
+      assert(!ok);
+    }
+    for (i = 0; i < count; i++) {
+      if (!jobs[i].res) continue;
+      if (jobs[i].index == best) res = jobs[i].res; else amhbi_free(1, jobs[i].res);
+    }
+  }
+  amhbi_free(1, base);
+  free(rems); free(composite); free(offsets); free(jobs);
+  return res;
+}
+
+
+static void
+amhbi_primes_init ()
+{
+  // Sieve of Eratosthenes
+  uint8_t *composite = calloc(AMHBI_PRIME_LIMIT, 1);
+  assert(composite);
+  uint64_t count = 0;
+  uint64_t i; for (i = 2; i < AMHBI_PRIME_LIMIT; i++) {
+    if (composite[i]) continue;
+    amhbi_primes[count++] = i;
+    uint64_t j; for (j = i * i; j < AMHBI_PRIME_LIMIT; j += i) composite[j] = 1;
+  }
+  assert(count == AMHBI_PRIME_COUNT);
+  free(composite);
+}
+
+
+static void
+amhbi_rem_primes (amhbi_t *num, uint32_t *rems)
+{
+  // As many primes at a time as their product fits 32 bits, so that one
+  // pass over the digits serves several of them
+  uint64_t i = 0;
+  while (i < AMHBI_PRIME_COUNT) {
+    uint64_t prod = 1;
+    uint64_t j = i;
+    while (j < AMHBI_PRIME_COUNT && prod * amhbi_primes[j] <= UINT32_MAX) prod *= amhbi_primes[j++];
+    uint64_t rem = amhbi_rem_word(num, prod);
+    for (; i < j; i++) rems[i] = rem % amhbi_primes[i];
+  }
+}
+
+
+static void *
+amhbi_sieve_worker (void *arg)
+{
+  // Survivors first, first + stride, ... in order; the first probable prime
+  // lowers the shared best index, which also stops every other thread once
+  // its candidates pass it
+  amhbi_sieve_job_t *job = arg;
+  uint64_t k; for (k = job->first; k < job->count; k += job->stride) {
+    if (k > __atomic_load_n(job->best, __ATOMIC_ACQUIRE)) break;
+    amhbi_t *step = amhbi_init_uint(job->offsets[k]);
+    amhbi_t *cand = amhbi_add(job->base, step);
+    amhbi_free(1, step);
+    if (!amhbi_is_probab_prime(cand, 0)) {
+      amhbi_free(1, cand);
+      continue;
+    }
+    job->res = cand;
+    job->index = k;
+    uint64_t best = __atomic_load_n(job->best, __ATOMIC_ACQUIRE);
+    while (k < best && !__atomic_compare_exchange_n(job->best, &best, k, 0,
+      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    break;
+  }
+  return NULL;
+}
+
+
+static uint8_t
+amhbi_mr (amhbi_mont_t *ctx, amhbi_t *d, uint64_t s, amhbi_t *base)
+{
+  // A prime has base^d = 1, or base^(d 2^r) = -1 for some r below s
+  amhbi_t *form = amhbi_mont_to(ctx, base);
+  amhbi_t *x = amhbi_mont_pow(ctx, form, d);
+  amhbi_t *minus = amhbi_subt(ctx->mod, ctx->one);
+  uint8_t prime = (!amhbi_cmp(x, ctx->one) || !amhbi_cmp(x, minus));
+  uint64_t r; for (r = 1; r < s && !prime; r++) {
+    amhbi_t *tmp = amhbi_mont_mul(ctx, x, x);
+    amhbi_free(1, x);
+    x = tmp;
+    if (!amhbi_cmp(x, ctx->one)) break;
+    prime = !amhbi_cmp(x, minus);
+  }
+  amhbi_free(3, form, x, minus);
+  return prime;
+}
+
+
+static uint8_t
+amhbi_lucas (amhbi_mont_t *ctx)
+{
+  // Selfridge's parameters; the first D of 5, -7, 9, -11, ... with Jacobi
+  // symbol (D / n) = -1, P = 1 and Q = (1 - D) / 4. Squares have no such D
+  amhbi_t *n = ctx->mod;
+  if (amhbi_issquare(n)) return 0;
+  int64_t D = 5;
+  int8_t jac;
+  while ((jac = amhbi_jacobi_word(D, n)) != -1) {
+    if (!jac) return 0;
+    D = (D > 0) ? -(D + 2) : -D + 2;
+  }
+  
+  // n + 1 = d * 2^s with d odd
+  amhbi_t *d = amhbi_init_cpy(n);
+  amhbi_incr(d);
+  uint64_t s = 0;
+  while (amhbi_iseven(d)) {
+    amhbi_t *tmp = amhbi_half(d);
+    amhbi_free(1, d);
+    d = tmp;
+    s++;
+  }
+  uint64_t count;
+  uint8_t *bits = amhbi_bits(d, &count);
+  amhbi_free(1, d);
+  
+  // U_k, V_k and Q^k from the top bit of d down; k doubles at every bit,
+  // and set bits add one
+  amhbi_t *tmp = amhbi_init_int(D);
+  amhbi_t *dm = amhbi_mont_to(ctx, tmp);
+  amhbi_free(1, tmp);
+  tmp = amhbi_init_int((1 - D) / 4);
+  amhbi_t *qm = amhbi_mont_to(ctx, tmp);
+  amhbi_free(1, tmp);
+  amhbi_t *u = amhbi_init_cpy(ctx->one);
+  amhbi_t *v = amhbi_init_cpy(ctx->one);
+  amhbi_t *qk = amhbi_init_cpy(qm);
+  uint64_t i; for (i = count - 1; i-- > 0;) {
+    amhbi_t *uv = amhbi_mont_mul(ctx, u, v);
+    amhbi_t *vv = amhbi_mont_mul(ctx, v, v);
+    amhbi_t *q2 = amhbi_mont_add(ctx, qk, qk);
+    amhbi_free(2, u, v);
+    u = uv;
+    v = amhbi_mont_sub(ctx, vv, q2);
+    tmp = amhbi_mont_mul(ctx, qk, qk);
+    amhbi_free(3, vv, q2, qk);
+    qk = tmp;
+    if (bits[i]) {
+      // U_k+1 = (U_k + V_k) / 2 and V_k+1 = (D U_k + V_k) / 2
+      amhbi_t *sum = amhbi_mont_add(ctx, u, v);
+      amhbi_t *du = amhbi_mont_mul(ctx, dm, u);
+      amhbi_t *dsum = amhbi_mont_add(ctx, du, v);
+      amhbi_free(2, u, v);
+      u = amhbi_mont_half(ctx, sum);
+      v = amhbi_mont_half(ctx, dsum);
+      tmp = amhbi_mont_mul(ctx, qk, qm);
+      amhbi_free(4, sum, du, dsum, qk);
+      qk = tmp;
+    }
+  }
+  
+  // Strong test; U_d = 0, or V_d 2^r = 0 for some r below s
+  uint8_t prime = (amhbi_iszero(u) || amhbi_iszero(v));
+  uint64_t r; for (r = 1; r < s && !prime; r++) {
+    amhbi_t *vv = amhbi_mont_mul(ctx, v, v);
+    amhbi_t *q2 = amhbi_mont_add(ctx, qk, qk);
+    amhbi_free(1, v);
+    v = amhbi_mont_sub(ctx, vv, q2);
+    tmp = amhbi_mont_mul(ctx, qk, qk);
+    amhbi_free(3, vv, q2, qk);
+    qk = tmp;
+    prime = amhbi_iszero(v);
+  }
+  amhbi_free(5, dm, qm, u, v, qk);
+  free(bits);
+  return prime;
+}
+
+
+static int8_t
+amhbi_jacobi_word (int64_t a, amhbi_t *n)
+{
+  // Factors of -1 and 2 by their supplementary laws, then reciprocity
+  // brings n down to a word
+  int8_t res = 1;
+  uint64_t n8 = amhbi_rem_word(n, 8);
+  uint64_t m = (a < 0) ? -(uint64_t)a : (uint64_t)a;
+  if (a < 0 && n8 % 4 == 3) res = -res;
+  if (!m) return 0;
+  while (m % 2 == 0) {
+    m /= 2;
+    if (n8 == 3 || n8 == 5) res = -res;
+  }
+  if (m % 4 == 3 && n8 % 4 == 3) res = -res;
+  uint64_t x = amhbi_rem_word(n, m);
+  while (x) {
+    while (x % 2 == 0) {
+      x /= 2;
+      if (m % 8 == 3 || m % 8 == 5) res = -res;
+    }
+    uint64_t t = x; x = m; m = t;
+    if (x % 4 == 3 && m % 4 == 3) res = -res;
+    x %= m;
+  }
+  return (m == 1) ? res : 0;
+}
+
+
+static uint8_t *
+amhbi_bits (amhbi_t *num, uint64_t *count)
+{
+  // One byte per bit of the binary words, least significant first
+  uint64_t n;
+  uint64_t *words = amhbi_to_words(num, &n);
+  uint8_t *bits = malloc(64 * n + 1);
+  assert(bits);
+  uint64_t k = 0;
+  uint64_t i; for (i = 0; i < n; i++) {
+    uint8_t j; for (j = 0; j < 64; j++) bits[k++] = (words[i] >> j) & 1;
+  }
+  while (k && !bits[k - 1]) k--;
+  free(words);
+  *count = k;
+  return bits;
+}
+
+
+/*
+ * Binary; magnitudes go to and from 64-bit words by splitting on the powers
+ * 2^(64 2^j), so a conversion costs a few products and divisions per level
+ * rather than a pass over every digit per word. Shifts by a few bits are
+ * done in place of a conversion, on base 10^8 limbs of the digits
+ */
+
+amhbi_t *
+amhbi_init_radix (char *str, uint8_t bits)
+{
+  assert(bits >= 1 && bits <= 5);
+  uint8_t sign = (*str == '-') ? 1 : 0;
+  if (*str == '-' || *str == '+') str++;
+  uint64_t len = strlen(str);
+  assert(len);
+  
+  // Digits are packed from the last one up, straight into the words
+  uint64_t n = (len * bits + 63) / 64;
+  uint64_t *words = calloc(n + 1, sizeof(uint64_t));
+  assert(words);
+  uint64_t pos = 0;
+  uint64_t i; for (i = len; i-- > 0; pos += bits) {
+    char c = tolower(str[i]);
+    uint64_t val = (c >= 'a') ? c - 'a' + 10 : c - '0';
+    assert(isalnum(c) && val < (1U << bits));
+    words[pos / 64] |= val << (pos % 64);
+    if (pos % 64 + bits > 64) words[pos / 64 + 1] |= val >> (64 - pos % 64);
+  }
+  amhbi_t *res = amhbi_from_words(words, n);
+  free(words);
+  if (!amhbi_iszero(res)) res->sign = sign;
+  return res;
+}
+
+
+amhbi_t *
+amhbi_init_hex (char *str)
+{
+  return amhbi_init_radix(str, 4);
+}
+
+
+amhbi_t *
+amhbi_init_bytes (const uint8_t *bytes, uint64_t n, uint8_t big)
+{
+  uint64_t *words = calloc(n / 8 + 1, sizeof(uint64_t));
+  assert(words);
+  uint64_t i; for (i = 0; i < n; i++) {
+    uint64_t val = bytes[(big) ? n - 1 - i : i];
+    words[i / 8] |= val << (8 * (i % 8));
+  }
+  amhbi_t *res = amhbi_from_words(words, n / 8 + 1);
+  free(words);
+  return res;
+}
+
+
+char *
+amhbi_to_radix (amhbi_t *num, uint8_t bits)
+{
+  assert(bits >= 1 && bits <= 5);
+  static const char alphabet[] = "0123456789abcdefghijklmnopqrstuv";
+  uint64_t n;
+  uint64_t *words = amhbi_to_words(num, &n);
+  uint64_t total = (n) ? 64 * n - __builtin_clzll(words[n - 1]) : 1;
+  uint64_t len = (total + bits - 1) / bits;
+  uint8_t sign = amhbi_sign(num);
+  char *str = malloc(len + sign + 1);
+  assert(str);
+  if (sign) str[0] = '-';
+  
+  // Digit i takes bits i bits .. (i + 1) bits - 1, possibly across two words
+  uint64_t i; for (i = 0; i < len; i++) {
+    uint64_t pos = i * bits;
+    uint64_t val = (n) ? words[pos / 64] >> (pos % 64) : 0;
+    if (pos % 64 + bits > 64 && pos / 64 + 1 < n) val |= words[pos / 64 + 1] << (64 - pos % 64);
+    str[sign + len - 1 - i] = alphabet[val & ((1U << bits) - 1)];
+  }
+  str[len + sign] = 0;
+  free(words);
+  return str;
+}
+
+
+char *
+amhbi_to_hex (amhbi_t *num)
+{
+  return amhbi_to_radix(num, 4);
+}
+
+
+uint8_t *
+amhbi_to_bytes (amhbi_t *num, uint64_t *n, uint8_t big)
+{
+  uint64_t count;
+  uint64_t *words = amhbi_to_words(num, &count);
+  uint64_t len = (count) ? 8 * count - __builtin_clzll(words[count - 1]) / 8 : 0;
+  uint8_t *bytes = malloc(len + 1);
+  assert(bytes);
+  uint64_t i; for (i = 0; i < len; i++) {
+    bytes[(big) ? len - 1 - i : i] = words[i / 8] >> (8 * (i % 8));
+  }
+  free(words);
+  *n = len;
+  return bytes;
+}
+
+
+amhbi_t *
+amhbi_shl (amhbi_t *num, uint64_t bits)
+{
+  // A few bits are multiplied into the limbs; more take a product with
+  // 2^bits, built straight from its one set bit
+  if (bits <= 32) {
+    uint8_t inexact;
+    amhbi_t *res = amhbi_shift_small(num, bits, 1, &inexact);
+    if (!amhbi_iszero(res)) res->sign = amhbi_sign(num);
+    return res;
+  }
+  uint64_t *words = calloc(bits / 64 + 1, sizeof(uint64_t));
+  assert(words);
+  words[bits / 64] = 1ULL << (bits % 64);
+  amhbi_t *pow = amhbi_from_words(words, bits / 64 + 1);
+  amhbi_t *res = amhbi_mult(num, pow);
+  amhbi_free(1, pow);
+  free(words);
+  return res;
+}
+
+
+amhbi_t *
+amhbi_shr (amhbi_t *num, uint64_t bits)
+{
+  // The magnitude is shifted down, then negative values round toward
+  // minus infinity whenever a set bit was shifted out
+  amhbi_t *res;
+  uint8_t inexact;
+  if (bits <= 32) {
+    res = amhbi_shift_small(num, bits, 0, &inexact);
+  } else {
+    uint64_t *words = calloc(bits / 64 + 1, sizeof(uint64_t));
+    assert(words);
+    words[bits / 64] = 1ULL << (bits % 64);
+    amhbi_t *pow = amhbi_from_words(words, bits / 64 + 1);
+    amhbi_t *abs = amhbi_abs(num);
+    amhbi_t **qr = amhbi_div(abs, pow);
+    res = qr[0];
+    inexact = !amhbi_iszero(qr[1]);
+    amhbi_free(3, pow, abs, qr[1]);
+    free(qr);
+    free(words);
+  }
+  if (amhbi_sign(num) && inexact) amhbi_incr(res);
+  if (!amhbi_iszero(res)) res->sign = amhbi_sign(num);
+  return res;
+}
+
+
+amhbi_t *
+amhbi_and (amhbi_t *num1, amhbi_t *num2)
+{
+  return amhbi_bitwise(num1, num2, '&');
+}
+
+
+amhbi_t *
+amhbi_or (amhbi_t *num1, amhbi_t *num2)
+{
+  return amhbi_bitwise(num1, num2, '|');
+}
+
+
+amhbi_t *
+amhbi_xor (amhbi_t *num1, amhbi_t *num2)
+{
+  return amhbi_bitwise(num1, num2, '^');
+}
+
+
+uint64_t
+amhbi_popcount (amhbi_t *num)
+{
+  uint64_t n;
+  uint64_t *words = amhbi_to_words(num, &n);
+  uint64_t count = 0;
+  uint64_t i; for (i = 0; i < n; i++) count += __builtin_popcountll(words[i]);
+  free(words);
+  return count;
+}
+
+
+uint64_t
+amhbi_scan1 (amhbi_t *num, uint64_t start)
+{
+  uint64_t n;
+  uint64_t *words = amhbi_to_words(num, &n);
+  uint64_t res = UINT64_MAX;
+  uint64_t i; for (i = start / 64; i < n; i++) {
+    uint64_t word = (i == start / 64) ? words[i] & (~0ULL << (start % 64)) : words[i];
+    if (word) {
+      res = 64 * i + __builtin_ctzll(word);
+      break;
+    }
+  }
+  free(words);
+  return res;
+}
+
+
+static uint64_t *
+amhbi_to_words (amhbi_t *num, uint64_t *count)
+{
+  // log2(10) < 3402 / 1024, so the words always fit
+  uint64_t size = amhbi_size(num);
+  uint64_t cap = size * 3402 / 1024 / 64 + 2;
+  uint64_t *words = calloc(cap, sizeof(uint64_t));
+  assert(words);
+  
+  // Powers 2^(64 2^j) up to about the square root of num
+  amhbi_t *pow[64];
+  pow[0] = amhbi_init_str("18446744073709551616");
+  uint64_t j = 0;
+  while (size > AMHBI_WORDS_BASECASE && 4 * amhbi_size(pow[j]) <= size + 2) {
+    pow[j + 1] = amhbi_mult(pow[j], pow[j]);
+    j++;
+  }
+  amhbi_t *abs = amhbi_abs(num);
+  amhbi_words_split(abs, words, pow, j);
+  amhbi_free(1, abs);
+  uint64_t i; for (i = 0; i <= j; i++) amhbi_free(1, pow[i]);
+  
+  while (cap && !words[cap - 1]) cap--;
+  *count = cap;
+  return words;
+}
+
+
+static void
+amhbi_words_split (amhbi_t *num, uint64_t *words, amhbi_t **pow, uint64_t j)
+{
+  // Short values are divided by 2^32 over and over, one pass per 32 bits
+  uint64_t size = amhbi_size(num);
+  if (size <= AMHBI_WORDS_BASECASE) {
+    uint64_t n = (size + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+    uint64_t limbs[n];
+    uint64_t i; for (i = 0; i < n; i++) limbs[i] = amhbi_ssa_limb(num, i);
+    while (n && !limbs[n - 1]) n--;
+    uint64_t k; for (k = 0; n; k++) {
+      uint64_t rem = 0;
+      for (i = n; i-- > 0;) {
+        uint64_t cur = rem * AMHBI_SSA_BASE + limbs[i];
+        limbs[i] = cur >> 32;
+        rem = cur & 0xffffffff;
+      }
+      while (n && !limbs[n - 1]) n--;
+      words[k / 2] |= rem << (32 * (k % 2));
+    }
+    return;
+  }
+  
+  // num = q 2^(64 2^j) + r; r fills exactly 2^j words, q the ones above
+  while (j && 2 * amhbi_size(pow[j]) > size + 1) j--;
+  amhbi_t **qr = amhbi_div(num, pow[j]);
+  amhbi_words_split(qr[1], words, pow, j);
+  amhbi_words_split(qr[0], &words[1ULL << j], pow, j);
+  amhbi_free(2, qr[0], qr[1]);
+  free(qr);
+}
+
+
+static amhbi_t *
+amhbi_from_words (uint64_t *words, uint64_t count)
+{
+  while (count && !words[count - 1]) count--;
+  if (!count) return amhbi_init_zero();
+  
+  // Powers 2^(64 2^j) below the top word
+  amhbi_t *pow[64];
+  pow[0] = amhbi_init_str("18446744073709551616");
+  uint64_t j = 0;
+  while ((2ULL << j) < count) {
+    pow[j + 1] = amhbi_mult(pow[j], pow[j]);
+    j++;
+  }
+  amhbi_t *res = amhbi_words_join(words, count, pow, j);
+  uint64_t i; for (i = 0; i <= j; i++) amhbi_free(1, pow[i]);
+  return res;
+}
+
+
+static amhbi_t *
+amhbi_words_join (uint64_t *words, uint64_t count, amhbi_t **pow, uint64_t j)
+{
+  // Short runs are multiplied into base 10^8 limbs 32 bits at a time
+  while (count && !words[count - 1]) count--;
+  if (count * 19 <= AMHBI_WORDS_BASECASE) {
+    uint64_t cap = count * 3 + 2;
+    uint64_t limbs[cap];
+    uint64_t n = 0;
+    uint64_t i; for (i = 2 * count; i-- > 0;) {
+      uint64_t carry = (words[i / 2] >> (32 * (i % 2))) & 0xffffffff;
+      uint64_t k; for (k = 0; k < n; k++) {
+        uint64_t cur = (limbs[k] << 32) + carry;
+        limbs[k] = cur % AMHBI_SSA_BASE;
+        carry = cur / AMHBI_SSA_BASE;
+      }
+      while (carry) {
+        limbs[n++] = carry % AMHBI_SSA_BASE;
+        carry /= AMHBI_SSA_BASE;
+      }
+    }
+    if (!n) return amhbi_init_zero();
+    amhbi_t *res = amhbi_init_empty(n * AMHBI_SSA_DIGITS);
+    char *digit = &res->digits[n * AMHBI_SSA_DIGITS];
+    for (i = 0; i < n; i++) {
+      uint64_t limb = limbs[i];
+      uint8_t k; for (k = 0; k < AMHBI_SSA_DIGITS; k++, limb /= 10) *--digit = (limb % 10) + '0';
+    }
+    return amhbi_trim(res);
+  }
+  
+  // hi 2^(64 2^j) + lo, splitting off the low 2^j words
+  while (j && (1ULL << j) >= count) j--;
+  amhbi_t *lo = amhbi_words_join(words, 1ULL << j, pow, j);
+  amhbi_t *hi = amhbi_words_join(&words[1ULL << j], count - (1ULL << j), pow, j);
+  amhbi_addmul(lo, hi, pow[j]);
+  amhbi_free(1, hi);
+  return lo;
+}
+
+
+static amhbi_t *
+amhbi_shift_small (amhbi_t *num, uint8_t bits, uint8_t left, uint8_t *inexact)
+{
+  // |num| times or divided by 2^bits, bits at most 32; each limb times 2^32
+  // still fits a word, and so does a remainder times 10^8
+  uint64_t size = amhbi_size(num);
+  uint64_t n = (size + AMHBI_SSA_DIGITS - 1) / AMHBI_SSA_DIGITS;
+  uint64_t out = (left) ? n + 2 : n;
+  amhbi_t *res = amhbi_init_empty(out * AMHBI_SSA_DIGITS);
+  char *digit = &res->digits[out * AMHBI_SSA_DIGITS];
+  *inexact = 0;
+  if (left) {
+    uint64_t carry = 0;
+    uint64_t i; for (i = 0; i < out; i++) {
+      uint64_t cur = ((i < n) ? (uint64_t)amhbi_ssa_limb(num, i) << bits : 0) + carry;
+      uint64_t limb = cur % AMHBI_SSA_BASE;
+      carry = cur / AMHBI_SSA_BASE;
+      uint8_t k; for (k = 0; k < AMHBI_SSA_DIGITS; k++, limb /= 10) *--digit = (limb % 10) + '0';
+    }
+  } else {
+    // High to low; limb i of the result is written i limbs up from the end
+    uint64_t rem = 0;
+    uint64_t mask = (1ULL << bits) - 1;
+    uint64_t i; for (i = n; i-- > 0;) {
+      uint64_t cur = rem * AMHBI_SSA_BASE + amhbi_ssa_limb(num, i);
+      uint64_t limb = cur >> bits;
+      rem = cur & mask;
+      char *end = &res->digits[(n - i) * AMHBI_SSA_DIGITS];
+      uint8_t k; for (k = 0; k < AMHBI_SSA_DIGITS; k++, limb /= 10) *--end = (limb % 10) + '0';
+    }
+    *inexact = (rem) ? 1 : 0;
+  }
+  return amhbi_trim(res);
+}
+
+
+static amhbi_t *
+amhbi_bitwise (amhbi_t *num1, amhbi_t *num2, char op)
+{
+  // Operands are taken in two's complement over one word more than the
+  // longer needs, so the top word carries the sign of the result
+  uint64_t n1, n2;
+  uint64_t *w1 = amhbi_to_words(num1, &n1);
+  uint64_t *w2 = amhbi_to_words(num2, &n2);
+  uint64_t n = ((n1 > n2) ? n1 : n2) + 1;
+  uint64_t *res = calloc(n, sizeof(uint64_t));
+  assert(res);
+  uint8_t neg1 = amhbi_sign(num1), neg2 = amhbi_sign(num2);
+  uint64_t carry1 = neg1, carry2 = neg2;
+  uint64_t i; for (i = 0; i < n; i++) {
+    uint64_t a = (i < n1) ? w1[i] : 0;
+    uint64_t b = (i < n2) ? w2[i] : 0;
+    if (neg1) { a = ~a + carry1; carry1 = carry1 && !a; }
+    if (neg2) { b = ~b + carry2; carry2 = carry2 && !b; }
+    res[i] = (op == '&') ? a & b : (op == '|') ? a | b : a ^ b;
+  }
+  
+  // Negative results are negated back to their magnitude
+  uint8_t sign = res[n - 1] >> 63;
+  uint64_t carry = sign;
+  if (sign) for (i = 0; i < n; i++) { res[i] = ~res[i] + carry; carry = carry && !res[i]; }
+  amhbi_t *num = amhbi_from_words(res, n);
+  if (!amhbi_iszero(num)) num->sign = sign;
+  free(w1); free(w2); free(res);
+  return num;
+}
+
+
+/*
+ * Rationals; the numerator carries the sign and the denominator is always
+ * positive. Canonical values are kept reduced by gcds of the smaller cross
+ * terms only. Lazy values skip reduction until they are compared, printed
+ * or grow past AMHBQ_LAZY_DIGITS
+ */
+
+amhbq_t *
+amhbq_init (amhbi_t *num, amhbi_t *den)
+{
+  assert(!amhbi_iszero(den));
+  amhbq_t *q = calloc(1, sizeof(amhbq_t));
+  assert(q);
+  q->num = amhbi_init_cpy(num);
+  q->den = amhbi_abs(den);
+  if (amhbi_sign(den) && !amhbi_iszero(num)) q->num->sign ^= 1;
+  amhbq_canon(q);
+  return q;
+}
+
+
+amhbq_t *
+amhbq_init_str (char *str)
+{
+  // "num/den", or just "num"
+  char *slash = strchr(str, '/');
+  if (!slash) {
+    amhbi_t *num = amhbi_init_str(str), *one = amhbi_init_int(1);
+    amhbq_t *q = amhbq_init(num, one);
+    amhbi_free(2, num, one);
+    return q;
+  }
+  char *head = strndup(str, slash - str);
+  assert(head);
+  amhbi_t *num = amhbi_init_str(head), *den = amhbi_init_str(slash + 1);
+  amhbq_t *q = amhbq_init(num, den);
+  amhbi_free(2, num, den);
+  free(head);
+  return q;
+}
+
+
+amhbq_t *
+amhbq_init_cpy (amhbq_t *q)
+{
+  amhbq_t *res = calloc(1, sizeof(amhbq_t));
+  assert(res);
+  res->num = amhbi_init_cpy(q->num);
+  res->den = amhbi_init_cpy(q->den);
+  res->lazy = q->lazy;
+  res->reduced = q->reduced;
+  return res;
+}
 
-amhbi_t *
-amhbi_pow (amhbi_t *num, amhbi_t *p)
+
+void
+amhbq_set_lazy (amhbq_t *q, uint8_t lazy)
 {
-  amhbi_t *res = amhbi_init_str("1");
-  amhbi_t *a = amhbi_init_cpy(num);
-  amhbi_t *b = amhbi_init_cpy(p);
+  q->lazy = lazy;
+  if (!lazy) amhbq_canon(q);
+}
 
-  // Perform iterated exponentiation by squaring
-  while (!amhbi_iszero(b)) {
-    if (amhbi_isodd(b)) {
-      // res *= a
-      amhbi_t *tmp = amhbi_mult(res, a); 
-      amhbi_free(1, res); 
-      res = tmp;
-      // b -= 1
-      amhbi_decr(b);
+
+void
+amhbq_canon (amhbq_t *q)
+{
+  if (q->reduced) return;
+  amhbi_t *g = amhbi_gcd_calc(q->num, q->den);
+  if (!amhbi_isunit(g)) {
+    amhbi_t *num = amhbi_divexact(q->num, g);
+    amhbi_t *den = amhbi_divexact(q->den, g);
+    amhbi_free(2, q->num, q->den);
+    q->num = num;
+    q->den = den;
+  }
+  amhbi_free(1, g);
+  q->reduced = 1;
+}
+
+
+amhbq_t *
+amhbq_add (amhbq_t *q1, amhbq_t *q2)
+{
+  return amhbq_addsub(q1, q2, 0);
+}
+
+
+amhbq_t *
+amhbq_subt (amhbq_t *q1, amhbq_t *q2)
+{
+  return amhbq_addsub(q1, q2, 1);
+}
+
+
+amhbq_t *
+amhbq_mult (amhbq_t *q1, amhbq_t *q2)
+{
+  return amhbq_muldiv(q1->num, q1->den, q2->num, q2->den, q1->lazy || q2->lazy);
+}
+
+
+amhbq_t *
+amhbq_div (amhbq_t *q1, amhbq_t *q2)
+{
+  // Times the reciprocal; its sign moves back up to the numerator
+  assert(!amhbi_iszero(q2->num));
+  amhbi_t *num = amhbi_abs(q2->den), *den = amhbi_abs(q2->num);
+  if (amhbi_sign(q2->num)) num->sign = 1;
+  amhbq_t *res = amhbq_muldiv(q1->num, q1->den, num, den, q1->lazy || q2->lazy);
+  amhbi_free(2, num, den);
+  return res;
+}
+
+
+int8_t
+amhbq_cmp (amhbq_t *q1, amhbq_t *q2)
+{
+  // Denominators are positive, reduced or not, so a / b against c / d is
+  // a d against c b; lazy values are left as they are
+  int8_t s1 = amhbi_sign(q1->num) ? -1 : !amhbi_iszero(q1->num);
+  int8_t s2 = amhbi_sign(q2->num) ? -1 : !amhbi_iszero(q2->num);
+  if (s1 != s2 || !s1) return (s1 > s2) - (s1 < s2);
+  if (amhbi_cmp(q1->den, q2->den) == 0) return amhbi_cmp(q1->num, q2->num);
+  amhbi_t *l = amhbi_mult(q1->num, q2->den);
+  amhbi_t *r = amhbi_mult(q2->num, q1->den);
+  int8_t res = amhbi_cmp(l, r);
+  amhbi_free(2, l, r);
+  return res;
+}
+
+
+char *
+amhbq_to_str (amhbq_t *q)
+{
+  amhbq_canon(q);
+  char *num = amhbi_to_str(q->num);
+  if (amhbi_isunit(q->den)) return num;
+  char *den = amhbi_to_str(q->den);
+  char *str = malloc(strlen(num) + strlen(den) + 2);
+  assert(str);
+  sprintf(str, "%s/%s", num, den);
+  free(num);
+  free(den);
+  return str;
+}
+
+
+void
+amhbq_free (int argc, ...)
+{
+  assert(argc > 0);
+  va_list args;
+  va_start(args, argc);
+  int i; for (i = 0; i < argc; i++) {
+    amhbq_t *q = va_arg(args, amhbq_t *);
+    if (q) {
+      amhbi_free(2, q->num, q->den);
+      free(q);
     }
-    // b /= 2
-    amhbi_t *tmp = amhbi_half(b); 
-    amhbi_free(1, b); 
-    b = tmp;
-    // a *= a
-    tmp = amhbi_mult(a, a); 
-    amhbi_free(1, a); 
-    a = tmp;
+  }
+  va_end(args);
+}
+
+
+static amhbq_t *
+amhbq_addsub (amhbq_t *q1, amhbq_t *q2, uint8_t sub)
+{
+  amhbq_t *res = calloc(1, sizeof(amhbq_t));
+  assert(res);
+  res->lazy = q1->lazy || q2->lazy;
+  
+  // Equal denominators only need the numerators combined
+  if (amhbi_cmp(q1->den, q2->den) == 0) {
+    res->num = (sub) ? amhbi_subt(q1->num, q2->num) : amhbi_add(q1->num, q2->num);
+    res->den = amhbi_init_cpy(q1->den);
+    amhbq_settle(res, amhbi_isunit(res->den));
+    return res;
+  }
+  if (res->lazy) {
+    res->num = amhbi_mult(q1->num, q2->den);
+    if (sub) amhbi_submul(res->num, q2->num, q1->den);
+    else amhbi_addmul(res->num, q2->num, q1->den);
+    res->den = amhbi_mult(q1->den, q2->den);
+    amhbq_settle(res, 0);
+    return res;
   }
   
-  amhbi_free(2, a, b);
+  // With g = gcd(b, d), a / b + c / d = (a (d / g) + c (b / g)) / (b d / g);
+  // what is left to cancel divides g, so the last gcd is taken against g
+  amhbi_t *g = amhbi_gcd_calc(q1->den, q2->den);
+  amhbi_t *b = amhbi_divexact(q1->den, g);
+  amhbi_t *d = amhbi_divexact(q2->den, g);
+  amhbi_t *t = amhbi_mult(q1->num, d);
+  if (sub) amhbi_submul(t, q2->num, b);
+  else amhbi_addmul(t, q2->num, b);
+  amhbi_t *g2 = amhbi_gcd_calc(t, g);
+  if (amhbi_iszero(t) || amhbi_isunit(g2)) {
+    res->num = t;
+    res->den = amhbi_mult(q1->den, d);
+  } else {
+    res->num = amhbi_divexact(t, g2);
+    amhbi_t *tmp = amhbi_divexact(q1->den, g2);
+    res->den = amhbi_mult(tmp, d);
+    amhbi_free(2, t, tmp);
+  }
+  amhbi_free(4, g, b, d, g2);
+  amhbq_settle(res, 1);
   return res;
 }
 
 
-static amhbi_t **
-amhbi_div (amhbi_t *num1, amhbi_t *num2)
+static amhbq_t *
+amhbq_muldiv (amhbi_t *a, amhbi_t *b, amhbi_t *c, amhbi_t *d, uint8_t lazy)
 {
-  // Create array of results (quotient, remainder)
-  amhbi_t **res = calloc(2, sizeof(amhbi_t *));
+  amhbq_t *res = calloc(1, sizeof(amhbq_t));
   assert(res);
+  res->lazy = lazy;
+  if (lazy) {
+    res->num = amhbi_mult(a, c);
+    res->den = amhbi_mult(b, d);
+    amhbq_settle(res, 0);
+    return res;
+  }
   
-  amhbi_t *tmpnum1 = amhbi_abs(num1);
-  amhbi_t *tmpnum2 = amhbi_abs(num2);
-  amhbi_t *quo = amhbi_init_zero();
-  amhbi_t *rem = amhbi_init_zero();
-  amhbi_t **split = amhbi_split(tmpnum1, 1);
-  amhbi_t *down = amhbi_init_cpy(split[0]);
-  amhbi_t *left = amhbi_init_cpy(split[1]);
-  uint64_t p = amhbi_size(tmpnum1);
-  if (p) p--;
-  
-  // Loop until there is nothing left to divide into
-  do {
-    // Keep pulling down digits until down is larger than num2
-    while (amhbi_cmp(down, tmpnum2) < 0) {
-      amhbi_free(2, split[0], split[1]); free(split);
-      split = amhbi_split(left, 1);
-      amhbi_t *tmp = amhbi_concat(2, down, split[0]);
-      amhbi_free(2, down, left);
-      down = tmp;
-      left = amhbi_init_cpy(split[1]);
-      if (p) p--;
-      if (amhbi_iszero(left)) break;
-    }
-  
-    // Calculate quotient, set remainder as next down
-    amhbi_t *tmp = amhbi_quo_slow(down, tmpnum2);
-    amhbi_t *tmp_pow = amhbi_mult_pow10(tmp, p);
-    amhbi_t *tmp_quo = amhbi_add(quo, tmp_pow);
-    amhbi_free(4, tmp, tmp_pow, quo, rem);
-    quo = tmp_quo;
-    rem = amhbi_rem_slow(down, tmpnum2);
-    amhbi_free(1, down); 
-    down = amhbi_init_cpy(rem);
-  } while (!amhbi_iszero(left));
-  amhbi_free(6, split[0], split[1], down, left, tmpnum1, tmpnum2);
-  free(split);
-  
-  // Set quotient (+ sign) and remainder
-  res[0] = quo; res[1] = rem;
-  res[0]->sign = (amhbi_sign(num1) == amhbi_sign(num2)) ? 0 : 1;
+  // (a / b) (c / d) of reduced operands can only cancel across, so gcd(a, d)
+  // and gcd(c, b) are all there is to take out
+  amhbi_t *g1 = amhbi_gcd_calc(a, d);
+  amhbi_t *g2 = amhbi_gcd_calc(c, b);
+  amhbi_t *x = amhbi_divexact(a, g1), *y = amhbi_divexact(c, g2);
+  amhbi_t *u = amhbi_divexact(b, g2), *v = amhbi_divexact(d, g1);
+  res->num = amhbi_mult(x, y);
+  res->den = amhbi_mult(u, v);
+  amhbi_free(6, g1, g2, x, y, u, v);
+  amhbq_settle(res, 1);
   return res;
 }
 
 
-amhbi_t *
-amhbi_quo (amhbi_t *num1, amhbi_t *num2)
+static void
+amhbq_settle (amhbq_t *q, uint8_t reduced)
 {
-  assert(!amhbi_iszero(num2));
-  if (!amhbi_cmp(num1, num2)) return amhbi_init_int(1);
-  amhbi_t **res = amhbi_div(num1, num2);
-  amhbi_t *quo = res[0]; amhbi_t *rem = res[1];
-  amhbi_free(1, rem); free(res);
-  return quo;
+  // Zero is 0 / 1; lazy values that got too long are reduced now
+  if (amhbi_iszero(q->num) && !amhbi_isunit(q->den)) {
+    amhbi_free(1, q->den);
+    q->den = amhbi_init_int(1);
+    reduced = 1;
+  }
+  q->reduced = reduced;
+  if (!q->lazy || amhbi_size(q->num) + amhbi_size(q->den) > AMHBQ_LAZY_DIGITS) amhbq_canon(q);
 }
 
 
-static amhbi_t *
-amhbi_quo_slow (amhbi_t *num1, amhbi_t *num2)
+/*
+ * Random numbers; SplitMix64 as a counter-based generator, so the k-th word
+ * of a stream depends only on its seed and k. Digits are filled eighteen
+ * at a time from words below 18 * 10^18, with long fills split by threads
+ */
+
+amhbi_rand_t *
+amhbi_rand_init (uint64_t seed)
 {
-  assert(!amhbi_iszero(num2));
-  if (amhbi_cmp(num1, num2) < 0) return amhbi_init_zero();
+  amhbi_rand_t *state = calloc(1, sizeof(amhbi_rand_t));
+  assert(state);
+  state->seed = seed;
+  return state;
+}
+
+
+amhbi_rand_t *
+amhbi_rand_split (amhbi_rand_t *state)
+{
+  // The child's seed is drawn from the parent's stream
+  return amhbi_rand_init(amhbi_rand_mix(amhbi_rand_next(state) ^ 0x6a09e667f3bcc909ULL));
+}
+
+
+void
+amhbi_rand_free (amhbi_rand_t *state)
+{
+  free(state);
+}
+
+
+amhbi_t *
+amhbi_urandomd (amhbi_rand_t *state, uint64_t n)
+{
+  if (!n) return amhbi_init_zero();
+  amhbi_t *res = amhbi_init_empty(n);
+  uint64_t words = (n + AMHBI_RAND_DIGITS - 1) / AMHBI_RAND_DIGITS;
   
-  // Perform iterative division by subtraction
-  amhbi_t *quo = amhbi_init_zero();
-  amhbi_t *rem = amhbi_init_cpy(num1);
-  while (amhbi_cmp(rem, num2) >= 0) {
-    amhbi_t *tmp = amhbi_subt(rem, num2);
-    amhbi_free(1, rem);
-    rem = tmp;
-    amhbi_incr(quo);
+  // Words are independent, so threads can take contiguous runs of them
+  uint64_t count = (n < AMHBI_RAND_PARALLEL) ? 1 : amhbi_get_threads();
+  if (count > words) count = words;
+  amhbi_rand_job_t *jobs = calloc(count, sizeof(amhbi_rand_job_t));
+  assert(jobs);
+  uint64_t i; for (i = 0; i < count; i++) {
+    uint64_t lo = words * i / count;
+    uint64_t hi = words * (i + 1) / count;
+    jobs[i].seed = state->seed;
+    jobs[i].counter = state->counter + lo;
+    jobs[i].digits = &res->digits[lo * AMHBI_RAND_DIGITS];
+    jobs[i].n = ((hi * AMHBI_RAND_DIGITS < n) ? hi * AMHBI_RAND_DIGITS : n) - lo * AMHBI_RAND_DIGITS;
   }
-  
-  amhbi_free(1, rem);
-  return quo;
+  for (i = 1; i < count; i++) {
+    int ok = pthread_create(&jobs[i].thread, NULL, amhbi_rand_worker, &jobs[i]);
+    assert(!ok);
+  }
+  amhbi_rand_worker(&jobs[0]);
+  for (i = 1; i < count; i++) {
+    int ok = pthread_join(jobs[i].thread, NULL);
+    assert(!ok);
+  }
+  free(jobs);
+  state->counter += words;
+  return amhbi_trim(res);
 }
 
 
 amhbi_t *
-amhbi_rem (amhbi_t *num1, amhbi_t *num2)
+amhbi_urandomb (amhbi_rand_t *state, uint64_t bits)
 {
-  assert(!amhbi_iszero(num2));
-  amhbi_t **res = amhbi_div(num1, num2);
-  amhbi_t *quo = res[0]; amhbi_t *rem = res[1];
-  amhbi_free(1, quo); free(res);
+  amhbi_t *two = amhbi_init_int(2);
+  amhbi_t *p = amhbi_init_uint(bits);
+  amhbi_t *bound = amhbi_pow_calc(two, p);
+  amhbi_t *res = amhbi_urandomm(state, bound);
+  amhbi_free(3, two, p, bound);
+  return res;
+}
+
+
+amhbi_t *
+amhbi_urandomm (amhbi_rand_t *state, amhbi_t *num)
+{
+  assert(!amhbi_sign(num) && !amhbi_iszero(num));
   
-  // Adjust result based on signs
-  if (amhbi_isneg(num1) && amhbi_isneg(num2)) {
-    amhbi_t *tmp = amhbi_negate(rem);
-    amhbi_free(1, rem);
-    return tmp;
-  } else if (amhbi_isneg(num1) && !amhbi_isneg(num2)) {
-    amhbi_t *tmp = amhbi_subt(num2, rem);
-    amhbi_free(1, rem);
-    return tmp;
-  } else if (!amhbi_isneg(num1) && amhbi_isneg(num2)) {
-    amhbi_t *tmp = amhbi_add(num2, rem);
-    amhbi_free(1, rem);
-    return tmp;
-  } else {
-    if (amhbi_cmp(num1, num2) < 0) return amhbi_init_cpy(num1);
-    return rem;
+  // The leading digits are drawn below the leading digits of num plus one,
+  // and the rest freely; only draws that tie on the leading digits can
+  // reach num and be rejected
+  uint64_t size = amhbi_size(num);
+  uint64_t lead = (size < AMHBI_RAND_DIGITS) ? size : AMHBI_RAND_DIGITS;
+  uint64_t top = 0;
+  uint64_t i; for (i = 0; i < lead; i++) top = top * 10 + (num->digits[i] - '0');
+  uint64_t limit = UINT64_MAX - UINT64_MAX % (top + 1);
+  for (;;) {
+    uint64_t x;
+    do x = amhbi_rand_next(state); while (x >= limit);
+    x %= top + 1;
+    amhbi_t *res = (size > lead) ? amhbi_urandomd(state, size - lead) : amhbi_init_zero();
+    
+    // Place x above the freely drawn digits
+    amhbi_t *tmp = amhbi_init_empty(size);
+    memset(tmp->digits, '0', size);
+    memcpy(&tmp->digits[size - amhbi_size(res)], res->digits, amhbi_size(res));
+    for (i = lead; i-- > 0; x /= 10) tmp->digits[i] = (x % 10) + '0';
+    amhbi_free(1, res);
+    amhbi_trim(tmp);
+    if (amhbi_cmp(tmp, num) < 0) return tmp;
+    amhbi_free(1, tmp);
+  }
+}
+
+
+static uint64_t
+amhbi_rand_mix (uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+
+static uint64_t
+amhbi_rand_next (amhbi_rand_t *state)
+{
+  return amhbi_rand_mix(state->seed + ++state->counter * 0x9e3779b97f4a7c15ULL);
+}
+
+
+static void *
+amhbi_rand_worker (void *arg)
+{
+  // Word k of the stream becomes digits 18k to 18k + 17; words past the
+  // largest multiple of 10^18 are redrawn from a stream keyed by attempt
+  amhbi_rand_job_t *job = arg;
+  const uint64_t limit = 18 * 1000000000000000000ULL;
+  uint64_t k; for (k = 0; k * AMHBI_RAND_DIGITS < job->n; k++) {
+    uint64_t ctr = job->counter + k + 1;
+    uint64_t x = amhbi_rand_mix(job->seed + ctr * 0x9e3779b97f4a7c15ULL);
+    uint64_t attempt; for (attempt = 1; x >= limit; attempt++) {
+      x = amhbi_rand_mix(amhbi_rand_mix(job->seed ^ attempt) + ctr * 0x9e3779b97f4a7c15ULL);
+    }
+    
+    // Two halves of nine digits each
+    uint32_t half[2] = {(x / 1000000000) % 1000000000, x % 1000000000};
+    uint64_t len = job->n - k * AMHBI_RAND_DIGITS;
+    if (len > AMHBI_RAND_DIGITS) len = AMHBI_RAND_DIGITS;
+    char *digit = &job->digits[k * AMHBI_RAND_DIGITS];
+    uint64_t j; for (j = AMHBI_RAND_DIGITS; j-- > 0;) {
+      uint32_t *h = &half[j / 9];
+      if (j < len) digit[j] = (*h % 10) + '0';
+      *h /= 10;
+    }
+  }
+  return NULL;
+}
+
+
+/*
+ * Memo cache; one lock guards the table, and results are computed outside
+ * it, so two threads missing on the same operands may both compute them
+ */
+
+static uint64_t amhbi_cache_budget = 0;
+static amhbi_cache_entry_t **amhbi_cache_table = NULL;
+static uint64_t amhbi_cache_buckets = 0;
+static amhbi_cache_entry_t *amhbi_cache_newest = NULL;
+static amhbi_cache_entry_t *amhbi_cache_oldest = NULL;
+static amhbi_cache_stats_t amhbi_cache_counts;
+static pthread_mutex_t amhbi_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static uint64_t
+amhbi_cache_hash (amhbi_cache_op_t op, amhbi_t **args, uint8_t argc)
+{
+  // Eight digits at a time, multiply and rotate; finished by SplitMix64
+  uint64_t h = op;
+  uint8_t a; for (a = 0; a < argc; a++) {
+    uint64_t size = amhbi_size(args[a]);
+    h = (h ^ (size << 1 | amhbi_sign(args[a]))) * 0x9e3779b97f4a7c15ULL;
+    uint64_t i; for (i = 0; i + 8 <= size; i += 8) {
+      uint64_t w;
+      memcpy(&w, &args[a]->digits[i], 8);
+      h = ((h ^ w) * 0xff51afd7ed558ccdULL);
+      h = (h << 31) | (h >> 33);
+    }
+    for (; i < size; i++) h = (h ^ args[a]->digits[i]) * 0x100000001b3ULL;
+  }
+  return amhbi_rand_mix(h);
+}
+
+
+static void
+amhbi_cache_drop (amhbi_cache_entry_t *entry)
+{
+  amhbi_cache_entry_t **link = &amhbi_cache_table[entry->hash & (amhbi_cache_buckets - 1)];
+  while (*link != entry) link = &(*link)->chain;
+  *link = entry->chain;
+  if (entry->newer) entry->newer->older = entry->older;
+  else amhbi_cache_newest = entry->older;
+  if (entry->older) entry->older->newer = entry->newer;
+  else amhbi_cache_oldest = entry->newer;
+  amhbi_cache_counts.entries--;
+  amhbi_cache_counts.bytes -= entry->bytes;
+  uint8_t a; for (a = 0; a < entry->argc; a++) amhbi_free(1, entry->args[a]);
+  amhbi_free(1, entry->res);
+  free(entry);
+}
+
+
+static amhbi_t *
+amhbi_cache_calc (amhbi_cache_op_t op, amhbi_t **args)
+{
+  switch (op) {
+    case AMHBI_CACHE_POW: return amhbi_pow_calc(args[0], args[1]);
+    case AMHBI_CACHE_POWM: return amhbi_powm_calc(args[0], args[1], args[2]);
+    case AMHBI_CACHE_QUO: return amhbi_quo_calc(args[0], args[1]);
+    case AMHBI_CACHE_REM: return amhbi_rem_calc(args[0], args[1]);
+    case AMHBI_CACHE_GCD: return amhbi_gcd_calc(args[0], args[1]);
+    case AMHBI_CACHE_SQRT: return amhbi_sqrt_calc(args[0]);
+    case AMHBI_CACHE_NEXTPRIME: return amhbi_nextprime_calc(args[0]);
   }
+  return NULL;
 }
 
 
 static amhbi_t *
-amhbi_rem_slow (amhbi_t *num1, amhbi_t *num2)
+amhbi_cached (amhbi_cache_op_t op, amhbi_t **args, uint8_t argc)
 {
-  assert(!amhbi_iszero(num2));
-  if (amhbi_cmp(num1, num2) < 0) return amhbi_init_cpy(num1);
+  if (!__atomic_load_n(&amhbi_cache_budget, __ATOMIC_RELAXED)) return amhbi_cache_calc(op, args);
+  uint64_t hash = amhbi_cache_hash(op, args, argc);
   
-  // Perform iterative division by subtraction
-  amhbi_t *quo = amhbi_init_zero();
-  amhbi_t *rem = amhbi_init_cpy(num1);
-  while (amhbi_cmp(rem, num2) >= 0) {
-    amhbi_t *tmp = amhbi_subt(rem, num2);
-    amhbi_free(1, rem);
-    rem = tmp;
-    amhbi_incr(quo);
+  // Hits move to the front of the recency list and hand out a shared copy
+  pthread_mutex_lock(&amhbi_cache_lock);
+  amhbi_cache_entry_t *entry = (amhbi_cache_buckets) ? amhbi_cache_table[hash & (amhbi_cache_buckets - 1)] : NULL;
+  for (; entry; entry = entry->chain) {
+    if (entry->hash != hash || entry->op != op) continue;
+    uint8_t a; for (a = 0; a < argc && !amhbi_cmp(entry->args[a], args[a]); a++);
+    if (a == argc) break;
+  }
+  if (entry) {
+    if (entry->newer) {
+      entry->newer->older = entry->older;
+      if (entry->older) entry->older->newer = entry->newer;
+      else amhbi_cache_oldest = entry->newer;
+      entry->older = amhbi_cache_newest;
+      entry->newer = NULL;
+      amhbi_cache_newest->newer = entry;
+      amhbi_cache_newest = entry;
+    }
+    amhbi_cache_counts.hits++;
+    amhbi_t *res = amhbi_init_cpy(entry->res);
+    pthread_mutex_unlock(&amhbi_cache_lock);
+    return res;
   }
+  amhbi_cache_counts.misses++;
+  pthread_mutex_unlock(&amhbi_cache_lock);
   
-  amhbi_free(1, quo);
-  return rem;
+  amhbi_t *res = amhbi_cache_calc(op, args);
+  uint64_t bytes = sizeof(amhbi_cache_entry_t) + sizeof(amhbi_t) + amhbi_size(res) + 1;
+  uint8_t a; for (a = 0; a < argc; a++) bytes += sizeof(amhbi_t) + amhbi_size(args[a]) + 1;
+  
+  pthread_mutex_lock(&amhbi_cache_lock);
+  if (bytes > amhbi_cache_budget) {
+    pthread_mutex_unlock(&amhbi_cache_lock);
+    return res;
+  }
+  
+  // Make room, oldest first; the table doubles once it averages one entry
+  // per bucket
+  while (amhbi_cache_counts.bytes + bytes > amhbi_cache_budget) {
+    amhbi_cache_drop(amhbi_cache_oldest);
+    amhbi_cache_counts.evictions++;
+  }
+  if (amhbi_cache_counts.entries + 1 > amhbi_cache_buckets) {
+    uint64_t buckets = (amhbi_cache_buckets) ? 2 * amhbi_cache_buckets : 64;
+    amhbi_cache_entry_t **table = calloc(buckets, sizeof(amhbi_cache_entry_t *));
+    assert(table);
+    uint64_t i; for (i = 0; i < amhbi_cache_buckets; i++) {
+      while (amhbi_cache_table[i]) {
+        amhbi_cache_entry_t *e = amhbi_cache_table[i];
+        amhbi_cache_table[i] = e->chain;
+        e->chain = table[e->hash & (buckets - 1)];
+        table[e->hash & (buckets - 1)] = e;
+      }
+    }
+    free(amhbi_cache_table);
+    amhbi_cache_table = table;
+    amhbi_cache_buckets = buckets;
+  }
+  
+  // Operands are kept as shared copies too
+  entry = calloc(1, sizeof(amhbi_cache_entry_t));
+  assert(entry);
+  entry->hash = hash;
+  entry->bytes = bytes;
+  entry->op = op;
+  entry->argc = argc;
+  for (a = 0; a < argc; a++) entry->args[a] = amhbi_init_cpy(args[a]);
+  entry->res = amhbi_init_cpy(res);
+  entry->chain = amhbi_cache_table[hash & (amhbi_cache_buckets - 1)];
+  amhbi_cache_table[hash & (amhbi_cache_buckets - 1)] = entry;
+  entry->older = amhbi_cache_newest;
+  if (amhbi_cache_newest) amhbi_cache_newest->newer = entry;
+  else amhbi_cache_oldest = entry;
+  amhbi_cache_newest = entry;
+  amhbi_cache_counts.entries++;
+  amhbi_cache_counts.bytes += bytes;
+  pthread_mutex_unlock(&amhbi_cache_lock);
+  return res;
+}
+
+
+void
+amhbi_cache_enable (uint64_t bytes)
+{
+  pthread_mutex_lock(&amhbi_cache_lock);
+  __atomic_store_n(&amhbi_cache_budget, bytes, __ATOMIC_RELAXED);
+  while (amhbi_cache_oldest && amhbi_cache_counts.bytes > bytes) {
+    amhbi_cache_drop(amhbi_cache_oldest);
+    amhbi_cache_counts.evictions++;
+  }
+  pthread_mutex_unlock(&amhbi_cache_lock);
+}
+
+
+void
+amhbi_cache_clear ()
+{
+  pthread_mutex_lock(&amhbi_cache_lock);
+  while (amhbi_cache_oldest) amhbi_cache_drop(amhbi_cache_oldest);
+  pthread_mutex_unlock(&amhbi_cache_lock);
+}
+
+
+void
+amhbi_cache_stats (amhbi_cache_stats_t *out)
+{
+  pthread_mutex_lock(&amhbi_cache_lock);
+  *out = amhbi_cache_counts;
+  out->budget = amhbi_cache_budget;
+  pthread_mutex_unlock(&amhbi_cache_lock);
 }
 
 
 amhbi_t *
-amhbi_half (amhbi_t *num)
+amhbi_pow (amhbi_t *num, amhbi_t *p)
 {
-  // Copy num, add a zero to the left; initialize result
-  amhbi_t *cpy = amhbi_init_empty(amhbi_size(num) + 1);
-  cpy->digits[0] = '0';
-  strncpy(&cpy->digits[1], num->digits, amhbi_size(num));
-  amhbi_t *res = amhbi_init_empty(amhbi_size(num));
-  
-  // Loop through the number, save results
-  uint64_t index_c = 0;
-  uint64_t index_r = 0;
-  while (index_c <= amhbi_size(num)) {
-    uint8_t even = (cpy->digits[index_c] % 2 == 0) ? 1 : 0;
-    switch (cpy->digits[++index_c]) {
-      case '0':
-      case '1': res->digits[index_r] = (even) ? '0' : '5'; break;
-      case '2':
-      case '3': res->digits[index_r] = (even) ? '1' : '6'; break;
-      case '4':
-      case '5': res->digits[index_r] = (even) ? '2' : '7'; break;
-      case '6':
-      case '7': res->digits[index_r] = (even) ? '3' : '8'; break;
-      case '8':
-      case '9': res->digits[index_r] = (even) ? '4' : '9'; break;
-    }
-    index_r++;
-  }
-  amhbi_free(1, cpy);
-  return amhbi_trim(res);
+  amhbi_t *args[] = {num, p};
+  return amhbi_cached(AMHBI_CACHE_POW, args, 2);
+}
+
+
+amhbi_t *
+amhbi_powm (amhbi_t *num, amhbi_t *p, amhbi_t *mod)
+{
+  amhbi_t *args[] = {num, p, mod};
+  return amhbi_cached(AMHBI_CACHE_POWM, args, 3);
+}
+
+
+amhbi_t *
+amhbi_quo (amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_t *args[] = {num1, num2};
+  return amhbi_cached(AMHBI_CACHE_QUO, args, 2);
+}
+
+
+amhbi_t *
+amhbi_rem (amhbi_t *num1, amhbi_t *num2)
+{
+  amhbi_t *args[] = {num1, num2};
+  return amhbi_cached(AMHBI_CACHE_REM, args, 2);
 }
 
 
 amhbi_t *
 amhbi_gcd (amhbi_t *num1, amhbi_t *num2)
 {
-  amhbi_t *a = amhbi_init_cpy(num1);
-  amhbi_t *b = amhbi_init_cpy(num2);
-  while (amhbi_cmp(a, b) != 0) {
-    if (amhbi_cmp(a, b) > 0) {
-      amhbi_t *tmp = amhbi_subt(a, b);
-      amhbi_free(1, a);
-      a = tmp;
-    } else {
-      amhbi_t *tmp = amhbi_subt(b, a);
-      amhbi_free(1, b);
-      b = tmp;
-    }
-  }
-  amhbi_free(1, b);
-  return a;
+  amhbi_t *args[] = {num1, num2};
+  return amhbi_cached(AMHBI_CACHE_GCD, args, 2);
+}
+
+
+amhbi_t *
+amhbi_sqrt (amhbi_t *num)
+{
+  return amhbi_cached(AMHBI_CACHE_SQRT, &num, 1);
+}
+
+
+amhbi_t *
+amhbi_nextprime (amhbi_t *num)
+{
+  return amhbi_cached(AMHBI_CACHE_NEXTPRIME, &num, 1);
 }
@@ -12,6 +12,14 @@
 #include <math.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 
 /*
@@ -26,6 +34,455 @@ typedef struct
 } amhbi_t;
 
 
+/*
+ * Products too long for the floating-point FFT are done slice by slice once
+ * one operand is this many times longer than the other
+ */
+
+#define AMHBI_UNBAL_RATIO 2
+
+
+/*
+ * Short products sum digit columns directly below this many digits, and
+ * leave out columns far enough down to be worth AMHBI_SHORT_GUARD digits
+ */
+
+#define AMHBI_SHORT_BASECASE 200
+#define AMHBI_SHORT_GUARD 8
+
+
+/*
+ * Division multiplies by a Newton reciprocal once the divisor has
+ * AMHBI_NEWTON_THRESHOLD digits; reciprocals of up to AMHBI_RECIP_BASECASE
+ * digits are found by long division, and quotients carry
+ * AMHBI_NEWTON_GUARD extra digits. Quotients AMHBI_DIV_BLOCKS times longer
+ * than the divisor, or than AMHBI_DIV_BLOCK digits if that is more, are
+ * found a block of that length at a time
+ */
+
+#define AMHBI_NEWTON_THRESHOLD 16
+#define AMHBI_RECIP_BASECASE 16
+#define AMHBI_NEWTON_GUARD 3
+#define AMHBI_DIV_BLOCK 4000
+#define AMHBI_DIV_BLOCKS 2
+
+
+/*
+ * Exact division finds quotients of up to AMHBI_DIVEXACT_BASECASE digits
+ * limb by limb. Longer ones are found a divisor length at a time once they
+ * are AMHBI_DIVEXACT_BLOCKS times longer than a divisor of at least
+ * AMHBI_DIV_BLOCK digits, and otherwise from a Hensel inverse up to
+ * AMHBI_DIVEXACT_HENSEL digits; plain division is faster for the rest
+ */
+
+#define AMHBI_DIVEXACT_BASECASE 400
+#define AMHBI_DIVEXACT_BLOCKS 4
+#define AMHBI_DIVEXACT_HENSEL 600000
+
+
+/*
+ * Binary conversions split values on powers 2^(64 2^j) down to runs of
+ * about this many digits, which are converted a word at a time
+ */
+
+#define AMHBI_WORDS_BASECASE 1200
+
+
+/*
+ * Square roots of up to this many digits are found by Newton iteration, and
+ * longer ones a quarter of the digits at a time from the root of the top half
+ */
+
+#define AMHBI_SQRT_BASECASE 64
+
+
+/*
+ * Perfect power tests screen each exponent with primes found by a sieve of
+ * up to this many numbers; larger ones are tested one at a time
+ */
+
+#define AMHBI_POWER_SIEVE (1 << 24)
+
+
+/*
+ * Gcds of numbers longer than AMHBI_GCD_HALF digits take half-gcd steps;
+ * the cofactors that halve the top half of both are found recursively, by
+ * Lehmer steps from AMHBI_HGCD_BASECASE digits down, and applied with fast
+ * products
+ */
+
+#define AMHBI_GCD_HALF 4000
+#define AMHBI_HGCD_BASECASE 400
+
+
+/*
+ * Rational; num / den with den positive. Reduced values are in lowest terms,
+ * and lazy ones are left unreduced until printed or longer than
+ * AMHBQ_LAZY_DIGITS digits in all
+ */
+
+#define AMHBQ_LAZY_DIGITS 4096
+
+typedef struct
+{
+  amhbi_t *num;
+  amhbi_t *den;
+  uint8_t lazy;
+  uint8_t reduced;
+} amhbq_t;
+
+
+/*
+ * Accumulator; unnormalized base 10^8 columns, one lane for positive and one
+ * for negative terms, with bound over every column. Products of at most
+ * AMHBI_ACC_LIMBS limbs each are summed into the columns directly, here and
+ * by amhbi_addmul
+ */
+
+#define AMHBI_ACC_LIMBS 16
+#define AMHBI_ACC_DIGITS 8
+#define AMHBI_ACC_BASE 100000000U
+
+typedef struct
+{
+  uint64_t size;
+  unsigned __int128 bound;
+  unsigned __int128 *cols[2];
+} amhbi_acc_t;
+
+
+/*
+ * Dot product job; one thread's share of the terms. Threads get at least
+ * AMHBI_DOT_CHUNK terms each
+ */
+
+#define AMHBI_DOT_CHUNK 4096
+
+typedef struct
+{
+  amhbi_t **num1;
+  amhbi_t **num2;
+  uint64_t lo;
+  uint64_t hi;
+  amhbi_acc_t *acc;
+  pthread_t thread;
+  uint64_t id;
+  uint64_t count;
+} amhbi_dot_job_t;
+
+
+/*
+ * Product tree node; the product of the absolute values of moduli lo to hi
+ */
+
+typedef struct amhbi_tree_s
+{
+  amhbi_t *num;
+  uint64_t lo;
+  uint64_t hi;
+  struct amhbi_tree_s *left;
+  struct amhbi_tree_s *right;
+} amhbi_tree_t;
+
+
+/*
+ * Tree job; one subtree's share of building or descending a product tree,
+ * with the number passed down and the value passed back up
+ */
+
+typedef struct
+{
+  amhbi_tree_t *node;
+  amhbi_t **nums;
+  amhbi_t **vals;
+  amhbi_t **out;
+  amhbi_t *num;
+  amhbi_t *res;
+  uint64_t lo;
+  uint64_t hi;
+  uint64_t threads;
+} amhbi_tree_job_t;
+
+
+/*
+ * Modular context; Montgomery form with R = 10^n when the modulus is coprime
+ * to 10, else n is zero and products are reduced by division
+ */
+
+typedef struct
+{
+  amhbi_t *mod;
+  amhbi_t *inv;
+  amhbi_t *one;
+  uint64_t n;
+} amhbi_mont_t;
+
+
+/*
+ * Sieve job; every stride-th survivor of a sieved window from first on,
+ * tested in order until one past the best index shared by all threads
+ */
+
+typedef struct
+{
+  amhbi_t *base;
+  uint64_t *offsets;
+  uint64_t count;
+  uint64_t first;
+  uint64_t stride;
+  uint64_t *best;
+  amhbi_t *res;
+  uint64_t index;
+  pthread_t thread;
+} amhbi_sieve_job_t;
+
+
+/*
+ * Random fill job; n digits from the stream words after counter
+ */
+
+typedef struct
+{
+  uint64_t seed;
+  uint64_t counter;
+  char *digits;
+  uint64_t n;
+  pthread_t thread;
+} amhbi_rand_job_t;
+
+
+/*
+ * Primality; the table holds the AMHBI_PRIME_COUNT primes below
+ * AMHBI_PRIME_LIMIT. Next-prime searches sieve windows of at least
+ * AMHBI_SIEVE_WINDOW numbers, whose survivors are shared between threads
+ * from AMHBI_SIEVE_PARALLEL digits on
+ */
+
+#define AMHBI_PRIME_LIMIT 65536
+#define AMHBI_PRIME_COUNT 6542
+#define AMHBI_SIEVE_WINDOW 4096
+#define AMHBI_SIEVE_PARALLEL 200
+
+
+/*
+ * Random state; a seed and the number of words drawn from its stream. Each
+ * word gives AMHBI_RAND_DIGITS digits, and numbers of AMHBI_RAND_PARALLEL
+ * digits or more are filled by several threads
+ */
+
+#define AMHBI_RAND_DIGITS 18
+#define AMHBI_RAND_PARALLEL (1 << 20)
+
+typedef struct
+{
+  uint64_t seed;
+  uint64_t counter;
+} amhbi_rand_t;
+
+
+/*
+ * Memo cache; results of expensive operations kept by operand content, in
+ * hash chains and a most recently used list, up to a byte budget
+ */
+
+typedef enum
+{
+  AMHBI_CACHE_POW, AMHBI_CACHE_POWM, AMHBI_CACHE_QUO, AMHBI_CACHE_REM,
+  AMHBI_CACHE_GCD, AMHBI_CACHE_SQRT, AMHBI_CACHE_NEXTPRIME
+} amhbi_cache_op_t;
+
+typedef struct amhbi_cache_entry_s
+{
+  uint64_t hash;
+  uint64_t bytes;
+  amhbi_cache_op_t op;
+  uint8_t argc;
+  amhbi_t *args[3];
+  amhbi_t *res;
+  struct amhbi_cache_entry_s *chain;
+  struct amhbi_cache_entry_s *newer;
+  struct amhbi_cache_entry_s *older;
+} amhbi_cache_entry_t;
+
+typedef struct
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t entries;
+  uint64_t bytes;
+  uint64_t budget;
+} amhbi_cache_stats_t;
+
+
+/*
+ * Instrumentation; probes count calls, the sum of operand sizes and how
+ * many fall below each power of two, and the deepest nesting of each probe.
+ * They are compiled in with AMHBI_INSTRUMENT and switched on at run time
+ */
+
+#define AMHBI_INSTR_COUNT 1
+#define AMHBI_INSTR_TRACE 2
+#define AMHBI_INSTR_BUCKETS 48
+
+typedef enum
+{
+  AMHBI_PROBE_ADD, AMHBI_PROBE_SUBT, AMHBI_PROBE_MULT, AMHBI_PROBE_MULT_LONG,
+  AMHBI_PROBE_MULT_DFFT, AMHBI_PROBE_MULT_NTT, AMHBI_PROBE_MULT_SSA,
+  AMHBI_PROBE_MULT_UNBAL, AMHBI_PROBE_MULMID, AMHBI_PROBE_DIV,
+  AMHBI_PROBE_DIV_LONG, AMHBI_PROBE_DIV_NEWTON, AMHBI_PROBE_RECIP,
+  AMHBI_PROBE_ROOT, AMHBI_PROBE_GCD, AMHBI_PROBE_POWM, AMHBI_PROBE_INIT_STR,
+  AMHBI_PROBE_TO_STR, AMHBI_PROBE_INIT_EMPTY, AMHBI_PROBE_TRIM,
+  AMHBI_PROBE_ALLOC, AMHBI_PROBES
+} amhbi_probe_t;
+
+typedef struct
+{
+  uint64_t calls[AMHBI_PROBES];
+  uint64_t total[AMHBI_PROBES];
+  uint64_t depth[AMHBI_PROBES];
+  uint64_t sizes[AMHBI_PROBES][AMHBI_INSTR_BUCKETS];
+} amhbi_instr_t;
+
+
+/*
+ * Trace event; one completed span, start and duration in nanoseconds
+ */
+
+typedef struct
+{
+  uint64_t probe;
+  uint64_t tid;
+  uint64_t start;
+  uint64_t dur;
+  uint64_t size;
+} amhbi_event_t;
+
+
+/*
+ * Per-thread instrumentation; counters and open nesting of one thread, and
+ * the spans it has recorded. Live threads are kept on a list so snapshots
+ * can sum them
+ */
+
+typedef struct amhbi_instr_thread_s
+{
+  amhbi_instr_t counts;
+  uint64_t nesting[AMHBI_PROBES];
+  amhbi_event_t *events;
+  uint64_t count;
+  uint64_t cap;
+  uint64_t tid;
+  struct amhbi_instr_thread_s *prev;
+  struct amhbi_instr_thread_s *next;
+} amhbi_instr_thread_t;
+
+
+/*
+ * Span; an open probe, closed when it goes out of scope. AMHBI_SPAN opens
+ * one for the rest of the enclosing function, AMHBI_COUNT only counts
+ */
+
+typedef struct
+{
+  uint64_t probe;
+  uint64_t size;
+  uint64_t start;
+  uint8_t flags;
+} amhbi_span_t;
+
+#ifdef AMHBI_INSTRUMENT
+#define AMHBI_SPAN(probe, size) \
+  amhbi_span_t amhbi_span __attribute__((cleanup(amhbi_instr_end))) = \
+    amhbi_instr_begin(probe, size)
+#define AMHBI_COUNT(probe, size) amhbi_instr_count(probe, size)
+#else
+#define AMHBI_SPAN(probe, size)
+#define AMHBI_COUNT(probe, size)
+#endif
+
+
+/*
+ * Storage block header; precedes every digit and transform buffer. Digits
+ * are shared between copies, refs counting the bigints that use them
+ */
+
+typedef struct
+{
+  uint64_t bytes;
+  uint64_t mapped;
+  uint64_t refs;
+  uint64_t pad;
+} amhbi_block_t;
+
+
+/*
+ * Transforms do all their levels on one block of about AMHBI_FFT_BLOCK bytes
+ * before moving to the next, so only the longer levels sweep whole buffers
+ */
+
+#define AMHBI_FFT_BLOCK (1 << 18)
+
+
+/*
+ * NTT plan; tables shared by every transform of one length and prime
+ */
+
+#define AMHBI_NTT_PRIMES 3
+#define AMHBI_NTT_MAXLOG 23
+#define AMHBI_NTT_DIGITS 8
+#define AMHBI_NTT_BASE 100000000ULL
+
+typedef struct
+{
+  uint64_t n;
+  uint64_t m;
+  uint64_t ninv;
+  uint64_t *roots;
+  uint64_t *iroots;
+} amhbi_nttplan_t;
+
+
+/*
+ * Floating-point FFT plan; twiddles for one complex transform length.
+ * Butterflies run in pairs on two-lane vectors
+ */
+
+#define AMHBI_DFFT_MAXLOG 24
+#define AMHBI_DFFT_CUTOFF 1500000
+
+typedef struct
+{
+  uint64_t n;
+  uint32_t *rev;
+  double *wr;
+  double *wi;
+} amhbi_dfftplan_t;
+
+typedef double amhbi_v2d_t __attribute__((vector_size(16)));
+
+
+/*
+ * Schonhage-Strassen parameters; elements use base 10^8 limbs
+ */
+
+#define AMHBI_SSA_MAXLOG 20
+#define AMHBI_SSA_DIGITS 8
+#define AMHBI_SSA_BASE 100000000U
+
+
+/*
+ * Multiplication plan; one operand kept in transformed form
+ */
+
+typedef struct
+{
+  amhbi_t *num;
+  uint64_t n;
+  uint64_t *spectrum[AMHBI_NTT_PRIMES];
+} amhbi_mulplan_t;
+
+
 /*
  * Initialization functions; use these to convert to bigints
  */
@@ -39,12 +496,24 @@ amhbi_t * amhbi_init_cpy (amhbi_t *num);
 /* Returns the bigint representation of the given string */
 amhbi_t * amhbi_init_str (char *str);
 
+/* Loads the given string into num, keeping its digit buffer when it is unshared and long enough */
+amhbi_t * amhbi_set_str (amhbi_t *num, char *str);
+
 /* Returns the bigint representation of the given signed int */
 amhbi_t * amhbi_init_int (int64_t val);
 
 /* Returns the bigint representation of the given unsigned int */
 amhbi_t * amhbi_init_uint (uint64_t val);
 
+/* Returns the bigint written in base 2^bits, for bits from 1 to 5 */
+amhbi_t * amhbi_init_radix (char *str, uint8_t bits);
+
+/* Returns the bigint written in hexadecimal */
+amhbi_t * amhbi_init_hex (char *str);
+
+/* Returns the bigint held in n bytes, most significant first if big is set */
+amhbi_t * amhbi_init_bytes (const uint8_t *bytes, uint64_t n, uint8_t big);
+
 
 /*
  * Arithmetic functions; these always return new bigints
@@ -71,21 +540,201 @@ amhbi_t * amhbi_mult_seq (int argc, ...);
 /* Multiply num1 by the given power of 10 */
 amhbi_t * amhbi_mult_pow10 (amhbi_t *num, uint64_t p);
 
+/* Multiply num by the given power of 10 in place */
+amhbi_t * amhbi_mult_pow10_to (amhbi_t *num, uint64_t p);
+
+/* Divide num by the given power of 10 in place; num must be a multiple */
+amhbi_t * amhbi_divexact_pow10 (amhbi_t *num, uint64_t p);
+
+/* Returns the low n digits of num1 * num2, with the product's sign */
+amhbi_t * amhbi_mullo (amhbi_t *num1, amhbi_t *num2, uint64_t n);
+
+/* Returns num1 * num2 without its low n digits, truncated towards zero */
+amhbi_t * amhbi_mulhi (amhbi_t *num1, amhbi_t *num2, uint64_t n);
+
+/* Returns the n digits of num1 * num2 from the lo-th up, with its sign */
+amhbi_t * amhbi_mulmid (amhbi_t *num1, amhbi_t *num2, uint64_t lo, uint64_t n);
+
+/* Adds num1 * num2 to acc in place */
+amhbi_t * amhbi_addmul (amhbi_t *acc, amhbi_t *num1, amhbi_t *num2);
+
+/* Subtracts num1 * num2 from acc in place */
+amhbi_t * amhbi_submul (amhbi_t *acc, amhbi_t *num1, amhbi_t *num2);
+
+/* Returns the sum of num1[i] * num2[i] for i below n */
+amhbi_t * amhbi_dot (uint64_t n, amhbi_t *num1[], amhbi_t *num2[]);
+
 /* Raise num to the p power */
 amhbi_t * amhbi_pow (amhbi_t *num, amhbi_t *p);
 
+/* Raise num to the p power modulo mod */
+amhbi_t * amhbi_powm (amhbi_t *num, amhbi_t *p, amhbi_t *mod);
+
+/* Returns the least probable prime greater than num */
+amhbi_t * amhbi_nextprime (amhbi_t *num);
+
 /* Divide num1 by num2; return the quotient */
 amhbi_t * amhbi_quo (amhbi_t *num1, amhbi_t *num2);
 
 /* Divide num1 by num2; return the remainder */
 amhbi_t * amhbi_rem (amhbi_t *num1, amhbi_t *num2);
 
-/* Quickly divide num by two; return the quotient */
+/* Divide num1 by num2, which must divide it exactly; return the quotient */
+amhbi_t * amhbi_divexact (amhbi_t *num1, amhbi_t *num2);
+
+/* Divide num by d, which must divide it exactly; return the quotient */
+amhbi_t * amhbi_divexact_ui (amhbi_t *num, uint64_t d);
+
+/* Returns the inverse of num modulo mod, or NULL when there is none */
+amhbi_t * amhbi_invmod (amhbi_t *num, amhbi_t *mod);
+
+/* Sets out[i] to the remainder of num by moduli[i], for each i below k; moduli must be non-zero, and k == 0 does nothing */
+void amhbi_rem_multi (amhbi_t *num, amhbi_t *moduli[], uint64_t k, amhbi_t *out[]);
+
+/* Returns the least x >= 0 with x = residues[i] mod moduli[i] for every i, or 0 when k == 0; moduli must be non-zero, and NULL is returned when two share a factor */
+amhbi_t * amhbi_crt (amhbi_t *residues[], amhbi_t *moduli[], uint64_t k);
+
+/* Quickly divide num by two; return the quotient of its absolute value */
 amhbi_t * amhbi_half (amhbi_t *num);
 
+/* Returns num * 2^bits */
+amhbi_t * amhbi_shl (amhbi_t *num, uint64_t bits);
+
+/* Returns num / 2^bits, rounded toward minus infinity */
+amhbi_t * amhbi_shr (amhbi_t *num, uint64_t bits);
+
+/* Bitwise and of num1 and num2, negatives taken in two's complement */
+amhbi_t * amhbi_and (amhbi_t *num1, amhbi_t *num2);
+
+/* Bitwise or of num1 and num2, negatives taken in two's complement */
+amhbi_t * amhbi_or (amhbi_t *num1, amhbi_t *num2);
+
+/* Bitwise exclusive or of num1 and num2, negatives taken in two's complement */
+amhbi_t * amhbi_xor (amhbi_t *num1, amhbi_t *num2);
+
 /* Returns the greatest common divisor of num1 and num2 */
 amhbi_t * amhbi_gcd (amhbi_t *num1, amhbi_t *num2);
 
+/* Returns the truncated square root of num */
+amhbi_t * amhbi_sqrt (amhbi_t *num);
+
+/* Returns the truncated square root of num and its remainder */
+amhbi_t ** amhbi_sqrtrem (amhbi_t *num);
+
+/* Returns the truncated k-th root of num */
+amhbi_t * amhbi_root_ui (amhbi_t *num, uint64_t k);
+
+
+/*
+ * Multiplication plans; use these to multiply one bigint by many others
+ */
+
+/* Returns a plan for multiplying num by bigints of up to maxsize digits */
+amhbi_mulplan_t * amhbi_mulplan_init (amhbi_t *num, uint64_t maxsize);
+
+/* Multiply num by the bigint the plan was made for */
+amhbi_t * amhbi_mulplan_mult (amhbi_mulplan_t *plan, amhbi_t *num);
+
+/* Destroys the given plan */
+void amhbi_mulplan_free (amhbi_mulplan_t *plan);
+
+
+/*
+ * Accumulators; use these to sum many bigints without a carry pass per term
+ */
+
+/* Returns an accumulator holding zero */
+amhbi_acc_t * amhbi_acc_init ();
+
+/* Adds num to the accumulator */
+void amhbi_acc_add (amhbi_acc_t *acc, amhbi_t *num);
+
+/* Subtracts num from the accumulator */
+void amhbi_acc_sub (amhbi_acc_t *acc, amhbi_t *num);
+
+/* Adds the given signed int to the accumulator */
+void amhbi_acc_add_int (amhbi_acc_t *acc, int64_t val);
+
+/* Adds num1 * num2 to the accumulator */
+void amhbi_acc_addmul (amhbi_acc_t *acc, amhbi_t *num1, amhbi_t *num2);
+
+/* Subtracts num1 * num2 from the accumulator */
+void amhbi_acc_submul (amhbi_acc_t *acc, amhbi_t *num1, amhbi_t *num2);
+
+/* Adds everything accumulated in other to acc; other is left unchanged */
+void amhbi_acc_merge (amhbi_acc_t *acc, amhbi_acc_t *other);
+
+/* Returns the accumulated value */
+amhbi_t * amhbi_acc_get (amhbi_acc_t *acc);
+
+/* Sets the accumulator back to zero, keeping its columns */
+void amhbi_acc_reset (amhbi_acc_t *acc);
+
+/* Destroys the given accumulator */
+void amhbi_acc_free (amhbi_acc_t *acc);
+
+
+/*
+ * Random numbers; use these to draw uniformly distributed bigints
+ */
+
+/* Returns a random state for the given seed */
+amhbi_rand_t * amhbi_rand_init (uint64_t seed);
+
+/* Returns a new random state seeded from the stream of state */
+amhbi_rand_t * amhbi_rand_split (amhbi_rand_t *state);
+
+/* Destroys the given random state */
+void amhbi_rand_free (amhbi_rand_t *state);
+
+/* Returns a random bigint from 0 to 10^n - 1 */
+amhbi_t * amhbi_urandomd (amhbi_rand_t *state, uint64_t n);
+
+/* Returns a random bigint from 0 to 2^bits - 1 */
+amhbi_t * amhbi_urandomb (amhbi_rand_t *state, uint64_t bits);
+
+/* Returns a random bigint from 0 to num - 1; num must be positive */
+amhbi_t * amhbi_urandomm (amhbi_rand_t *state, amhbi_t *num);
+
+
+/*
+ * Memo cache; pow, powm, quo, rem, gcd, sqrt and nextprime return shared
+ * copies of earlier results for the same operands while it is enabled
+ */
+
+/* Enables the cache with a budget of the given bytes; 0 disables and empties it */
+void amhbi_cache_enable (uint64_t bytes);
+
+/* Drops every cached result */
+void amhbi_cache_clear ();
+
+/* Sets out to the cache's counters */
+void amhbi_cache_stats (amhbi_cache_stats_t *out);
+
+
+/*
+ * Instrumentation; probes only record when the library is built with
+ * AMHBI_INSTRUMENT
+ */
+
+/* Switches probes on; flags is AMHBI_INSTR_COUNT, AMHBI_INSTR_TRACE or both */
+void amhbi_instr_enable (uint8_t flags);
+
+/* Sets out to the counters summed over every thread */
+void amhbi_instr_snapshot (amhbi_instr_t *out);
+
+/* Zeroes every thread's counters and drops recorded spans */
+void amhbi_instr_reset ();
+
+/* Returns the name of the given probe */
+const char * amhbi_instr_name (amhbi_probe_t probe);
+
+/* Prints a table of the counters in out */
+void amhbi_instr_print (FILE *file, amhbi_instr_t *out);
+
+/* Writes recorded spans in Chrome trace event format */
+void amhbi_instr_trace (FILE *file);
+
 
 /*
  * Utility functions
@@ -94,6 +743,15 @@ amhbi_t * amhbi_gcd (amhbi_t *num1, amhbi_t *num2);
 /* Destroys each of the given bigints */
 void amhbi_free (int argc, ...);
 
+/* Backs buffers of at least threshold bytes by temporary files in dir */
+void amhbi_set_tmpdir (const char *dir, uint64_t threshold);
+
+/* Caps the threads used by parallel kernels; 0 uses every processor */
+void amhbi_set_threads (uint64_t n);
+
+/* Builds the NTT plans for every transform length up to n ahead of time */
+void amhbi_ntt_prewarm (uint64_t n);
+
 /* Returns the size in digits of num */
 uint64_t amhbi_size (amhbi_t *num);
 
@@ -124,6 +782,15 @@ uint8_t amhbi_iszero (amhbi_t *num);
 /* Checks if num is either 1 or -1 */
 uint8_t amhbi_isunit (amhbi_t *num);
 
+/* Checks if num is a perfect square */
+uint8_t amhbi_issquare (amhbi_t *num);
+
+/* Checks if num is a perfect power (a^b for some b > 1) */
+uint8_t amhbi_ispower (amhbi_t *num);
+
+/* Checks if num is prime; 2 if surely, 1 if probably, after reps extra rounds */
+uint8_t amhbi_is_probab_prime (amhbi_t *num, uint64_t reps);
+
 /* Returns a copy of the absolute value of num */
 amhbi_t * amhbi_abs (amhbi_t *num);
 
@@ -145,6 +812,12 @@ amhbi_t * amhbi_min (int argc, ...);
 /* Compare num1 to num2 */
 int8_t amhbi_cmp (amhbi_t *num1, amhbi_t *num2);
 
+/* Returns the number of set bits in the absolute value of num */
+uint64_t amhbi_popcount (amhbi_t *num);
+
+/* Returns the index of the lowest set bit of |num| at or above start, or UINT64_MAX */
+uint64_t amhbi_scan1 (amhbi_t *num, uint64_t start);
+
 
 /*
  * Conversion functions; use these to convert from bigints
@@ -159,6 +832,56 @@ int64_t amhbi_to_int (amhbi_t *num);
 /* Returns the unsigned int representation of the given bigint; truncates! */
 uint64_t amhbi_to_uint (amhbi_t *num);
 
+/* Returns num written in base 2^bits, for bits from 1 to 5 */
+char * amhbi_to_radix (amhbi_t *num, uint8_t bits);
+
+/* Returns num written in hexadecimal */
+char * amhbi_to_hex (amhbi_t *num);
+
+/* Returns |num| as *n bytes, most significant first if big is set */
+uint8_t * amhbi_to_bytes (amhbi_t *num, uint64_t *n, uint8_t big);
+
+
+/*
+ * Rational functions; these always return new rationals
+ */
+
+/* Returns num / den in lowest terms; den must not be zero */
+amhbq_t * amhbq_init (amhbi_t *num, amhbi_t *den);
+
+/* Returns the rational written as "num/den" or "num" */
+amhbq_t * amhbq_init_str (char *str);
+
+/* Returns an exact copy of q */
+amhbq_t * amhbq_init_cpy (amhbq_t *q);
+
+/* Turns lazy reduction of q on or off; results are lazy if either operand is */
+void amhbq_set_lazy (amhbq_t *q, uint8_t lazy);
+
+/* Reduces q to lowest terms in place */
+void amhbq_canon (amhbq_t *q);
+
+/* Sum q1 and q2 */
+amhbq_t * amhbq_add (amhbq_t *q1, amhbq_t *q2);
+
+/* Subtract q2 from q1 */
+amhbq_t * amhbq_subt (amhbq_t *q1, amhbq_t *q2);
+
+/* Multiply q1 and q2 */
+amhbq_t * amhbq_mult (amhbq_t *q1, amhbq_t *q2);
+
+/* Divide q1 by q2; q2 must not be zero */
+amhbq_t * amhbq_div (amhbq_t *q1, amhbq_t *q2);
+
+/* Compare q1 to q2 by cross multiplication, without reducing either */
+int8_t amhbq_cmp (amhbq_t *q1, amhbq_t *q2);
+
+/* Returns the string representation of q in lowest terms */
+char * amhbq_to_str (amhbq_t *q);
+
+/* Destroys the given rationals */
+void amhbq_free (int argc, ...);
+
 
 /*
  * Helper functions
@@ -167,44 +890,375 @@ uint64_t amhbi_to_uint (amhbi_t *num);
 /* Returns an empty bigint of the given length */
 static amhbi_t * amhbi_init_empty (uint64_t length);
 
+/* Returns a copy of the temporary directory if buffers of bytes go there */
+static char * amhbi_tmpdir_for (uint64_t bytes);
+
+/* Returns a zeroed buffer, file backed if it is large enough */
+static void * amhbi_alloc (uint64_t bytes);
+
+/* Resizes a buffer from amhbi_alloc; new bytes are not zeroed */
+static void * amhbi_realloc (void *ptr, uint64_t bytes);
+
+/* Releases a buffer from amhbi_alloc */
+static void amhbi_dealloc (void *ptr);
+
+/* Takes another reference to a digit buffer */
+static char * amhbi_share (char *digits);
+
+/* Drops a reference to a digit buffer, freeing it with the last one */
+static void amhbi_release (char *digits);
+
+/* Gives num digits of its own, ready to be written in place */
+static amhbi_t * amhbi_own (amhbi_t *num);
+
 /* Trims leading zeros from num */
 static amhbi_t * amhbi_trim (amhbi_t *num);
 
 /* Splits num at the given index */
 static amhbi_t ** amhbi_split (amhbi_t *num, uint64_t i);
 
-/* Split used by fft multiplication */
-static int64_t * amhbi_split_ntt (amhbi_t *num, uint64_t n);
+/* Returns the n digits of the absolute value of num from the lo-th up */
+static amhbi_t * amhbi_slice (amhbi_t *num, uint64_t lo, uint64_t n);
 
-/* Concatenate a sequence of bigints */
-static amhbi_t * amhbi_concat (int argc, ...);
+/* Split used by fft multiplication; base 10^8 coefficients */
+static uint64_t * amhbi_split_ntt (amhbi_t *num, uint64_t n);
 
 /* Multiply two numbers together using long multiplication */
 static amhbi_t * amhbi_mult_long (amhbi_t *num1, amhbi_t *num2);
 
-/* Multiply two numbers together using the Karatsuba algorithm */
-static amhbi_t * amhbi_mult_karatsuba (amhbi_t *num1, amhbi_t *num2);
+/* Digit columns lo to hi of the product of the absolute values, carried */
+static amhbi_t * amhbi_mult_range (amhbi_t *num1, amhbi_t *num2, uint64_t lo, uint64_t hi);
+
+/* Short product through the transforms; NULL if the guard digits fail */
+static amhbi_t * amhbi_mulmid_transform (amhbi_t *num1, amhbi_t *num2, uint64_t cut, uint64_t lo, uint64_t hi);
+
+/* Digits lo to lo + n of a partial product, or NULL if they are in doubt */
+static amhbi_t * amhbi_mulmid_take (amhbi_t *part, uint64_t lo, uint64_t n, uint8_t dropped, uint64_t wrap);
+
+/* Multiplies through whichever transform suits the product length */
+static amhbi_t * amhbi_mult_transform (amhbi_t *num1, amhbi_t *num2);
+
+/* Multiplies operands of very different lengths slice by slice */
+static amhbi_t * amhbi_mult_unbal (amhbi_t *num1, amhbi_t *num2);
 
 /* Multiply two numbers together using FFTs */
 static amhbi_t * amhbi_mult_fft (amhbi_t *num1, amhbi_t *num2);
 
-/* Number-theoretic transform */
-static int64_t * amhbi_fft (int64_t *a, long double w, uint64_t n, uint64_t m);
+/* Magnitude of num1 * num2 modulo 10^8n - 1 by a cyclic NTT of length n */
+static amhbi_t * amhbi_mult_wrap (amhbi_t *num1, amhbi_t *num2, uint64_t n);
+
+/* Returns the cached plan for a transform of length n modulo the prime */
+static amhbi_nttplan_t * amhbi_ntt_plan (uint64_t n, uint8_t prime);
+
+/* In-place NTT into bit reversed order, or the inverse back to natural order */
+static void amhbi_ntt (uint64_t *a, amhbi_nttplan_t *plan, uint8_t inverse);
+
+/* One level of butterflies of length len over a[lo] to a[hi - 1] */
+static void amhbi_ntt_pass (uint64_t *a, amhbi_nttplan_t *plan, uint64_t len, uint64_t lo, uint64_t hi, uint8_t inverse);
 
-/* Inverse number-theoretic transform */
-static int64_t * amhbi_ifft (int64_t *a, long double w, uint64_t n, uint64_t m);
+/* Recombines per-prime convolutions; the top carry goes to wrap if given */
+static amhbi_t * amhbi_ntt_combine (uint64_t **res, uint64_t n, uint64_t *wrap);
 
-/* Modular exponentiation */
-static int64_t amhbi_ifft_pow (uint64_t n, int64_t p, uint64_t m);
+/* Multiply two numbers together using floating-point FFTs when provably exact */
+static amhbi_t * amhbi_mult_dfft (amhbi_t *num1, amhbi_t *num2);
+
+/* Returns the cached plan for a complex transform of length 2^lg */
+static amhbi_dfftplan_t * amhbi_dfft_plan (uint64_t lg);
+
+/* In-place complex double FFT, radix-4 with one radix-2 level if needed */
+static void amhbi_dfft (double *re, double *im, amhbi_dfftplan_t *plan);
+
+/* Multiply two numbers together using Schonhage-Strassen */
+static amhbi_t * amhbi_mult_ssa (amhbi_t *num1, amhbi_t *num2);
+
+/* Returns the i-th base 10^8 limb of num, least significant first */
+static uint32_t amhbi_ssa_limb (amhbi_t *num, uint64_t i);
+
+/* Sum of two elements of Z / (10^8L + 1) */
+static void amhbi_ssa_add (uint32_t *r, uint32_t *a, uint32_t *b, uint64_t L);
+
+/* Difference of two elements of Z / (10^8L + 1) */
+static void amhbi_ssa_sub (uint32_t *r, uint32_t *a, uint32_t *b, uint64_t L);
+
+/* Multiply an element of Z / (10^8L + 1) by 10^8s */
+static void amhbi_ssa_shift (uint32_t *r, uint32_t *a, uint64_t s, uint64_t L, uint32_t *tmp);
+
+/* Product of two elements of Z / (10^8L + 1) */
+static void amhbi_ssa_mulmod (uint32_t *r, uint32_t *a, uint32_t *b, uint64_t L);
+
+/* Converts an element of Z / (10^8L + 1) to a bigint */
+static amhbi_t * amhbi_ssa_to_bigint (uint32_t *a, uint64_t L);
+
+/* In-place transform over Z / (10^8L + 1), or its unscaled inverse */
+static void amhbi_ssa_fft (uint32_t **a, uint64_t K, uint64_t L, uint8_t inverse, uint32_t *tmp);
+
+/* One level of butterflies of length len over elements lo to hi - 1 */
+static void amhbi_ssa_pass (uint32_t **a, uint64_t L, uint64_t step, uint64_t len, uint64_t lo, uint64_t hi, uint8_t inverse, uint32_t *tmp);
+
+/* Returns the thread count set by amhbi_set_threads, or the processor count */
+static uint64_t amhbi_get_threads ();
+
+/* Adds num1 * num2, or its negation, to num in place */
+static amhbi_t * amhbi_addmul_to (amhbi_t *num, amhbi_t *num1, amhbi_t *num2, uint8_t negate);
+
+/* Adds the tsize digits of a term with the given sign to num in place */
+static amhbi_t * amhbi_add_to (amhbi_t *num, char *digits, uint64_t tsize, uint8_t sign);
+
+/* Runs one dot product job, then merges the jobs below it in the tree */
+static void * amhbi_dot_worker (void *arg);
+
+/* Makes room for a term of size columns adding at most add to each column */
+static void amhbi_acc_reserve (amhbi_acc_t *acc, uint64_t size, unsigned __int128 add);
+
+/* Propagates carries until every column is a single limb */
+static void amhbi_acc_norm (amhbi_acc_t *acc);
+
+/* Adds the limbs of num, or of its negation, to the accumulator */
+static void amhbi_acc_limbs (amhbi_acc_t *acc, amhbi_t *num, uint8_t negate);
+
+/* Adds num1 * num2, or its negation, to the accumulator */
+static void amhbi_acc_term (amhbi_acc_t *acc, amhbi_t *num1, amhbi_t *num2, uint8_t negate);
+
+/* Returns base 10^8 limb i of num, counting up from the least significant */
+static uint64_t amhbi_acc_limb (amhbi_t *num, uint64_t i);
+
+/* Sums the limb products of two terms of at most AMHBI_ACC_LIMBS limbs into cols */
+static void amhbi_acc_kernel (unsigned __int128 *cols, amhbi_t *num1, amhbi_t *num2);
 
 /* Divide num1 by num2; return quotient and remainder */
 static amhbi_t ** amhbi_div (amhbi_t *num1, amhbi_t *num2);
 
-/* Divide by iterated subtraction; return the quotient */
-static amhbi_t * amhbi_quo_slow (amhbi_t *num1, amhbi_t *num2);
+/* Division one digit at a time */
+static amhbi_t ** amhbi_div_long (amhbi_t *num1, amhbi_t *num2);
+
+/* Division by multiplying with a Newton reciprocal of the divisor */
+static amhbi_t ** amhbi_div_newton (amhbi_t *num1, amhbi_t *num2);
+
+/* Division of the magnitudes l quotient digits at a time, by recip */
+static amhbi_t ** amhbi_div_blocks (amhbi_t *num1, amhbi_t *num2, amhbi_t *recip, uint64_t k, uint64_t l);
+
+/* Division of the magnitudes by recip, for quotients of up to k - guard digits */
+static amhbi_t ** amhbi_div_recip (amhbi_t *num1, amhbi_t *num2, amhbi_t *recip, uint64_t k);
+
+/* Approximates 10^2k / num for a k digit num, to a few units */
+static amhbi_t * amhbi_recip (amhbi_t *num, uint64_t k);
+
+/* Replaces num by whichever of num, num - mod and num + mod is smallest */
+static amhbi_t * amhbi_centre (amhbi_t *num, amhbi_t *mod);
+
+/* Absolute value of num modulo 10^N - 1, possibly equal to it */
+static amhbi_t * amhbi_fold (amhbi_t *num, uint64_t N);
+
+/* Runs fn on both jobs, on two threads if threads allows it */
+static void amhbi_tree_fork (void *(*fn) (void *), amhbi_tree_job_t *left, amhbi_tree_job_t *right, uint64_t threads);
+
+/* Builds the product tree of moduli lo to hi */
+static void * amhbi_tree_build (void *arg);
+
+/* Reduces num down the tree, setting the remainder at each leaf */
+static void * amhbi_tree_rem (void *arg);
+
+/* Interpolates the residues of a subtree, given its cofactor modulo it */
+static void * amhbi_tree_crt (void *arg);
+
+/* Destroys a product tree */
+static void amhbi_tree_free (amhbi_tree_t *node);
+
+/* Returns A a + B b, known to be non-negative and no longer than a */
+static amhbi_t * amhbi_gcd_comb (amhbi_t *a, amhbi_t *b, int64_t A, int64_t B);
+
+/* One Lehmer step, or a full Euclid step, on a >= b; its cofactors are applied to m unless NULL */
+static void amhbi_lehmer_step (amhbi_t **a, amhbi_t **b, amhbi_t *m[4]);
+
+/* Takes a >= b down to about half the length of a; m, unless NULL, is set to the cofactors */
+static void amhbi_hgcd (amhbi_t **a, amhbi_t **b, amhbi_t *m[4]);
+
+/* Replaces a and b by m (a, b), made non-negative with a >= b, fixing up the rows of m to match */
+static void amhbi_hgcd_apply (amhbi_t **a, amhbi_t **b, amhbi_t *m[4]);
+
+/* Sets m to n m */
+static void amhbi_hgcd_mul (amhbi_t *m[4], amhbi_t *n[4]);
+
+/* Remainder of the absolute value of num by a word sized modulus */
+static uint64_t amhbi_rem_word (amhbi_t *num, uint64_t m);
+
+/* Truncated k-th root of a non-negative num by Newton iteration */
+static amhbi_t * amhbi_root_newton (amhbi_t *num, uint64_t k);
+
+/* Square root of a non-negative num, with num - root^2 in rem */
+static amhbi_t * amhbi_sqrtrem_rec (amhbi_t *num, amhbi_t **rem);
+
+/* Compares r^k against val without overflowing */
+static int8_t amhbi_root_cmp_word (uint64_t r, uint64_t k, uint64_t val);
+
+/* Checks if the word n is prime */
+static uint8_t amhbi_isprime_word (uint64_t n);
+
+/* Modular exponentiation of words */
+static uint64_t amhbi_powm_word (uint64_t b, uint64_t e, uint64_t m);
+
+
+/* Returns a modular context for mod */
+static amhbi_mont_t * amhbi_mont_init (amhbi_t *mod);
+
+/* Montgomery reduction; num * R^-1 modulo mod, for num below mod * R */
+static amhbi_t * amhbi_mont_redc (amhbi_mont_t *ctx, amhbi_t *num);
+
+/* Product of two numbers in the context's form */
+static amhbi_t * amhbi_mont_mul (amhbi_mont_t *ctx, amhbi_t *num1, amhbi_t *num2);
+
+/* Sum of two numbers in the context's form */
+static amhbi_t * amhbi_mont_add (amhbi_mont_t *ctx, amhbi_t *num1, amhbi_t *num2);
+
+/* Difference of two numbers in the context's form */
+static amhbi_t * amhbi_mont_sub (amhbi_mont_t *ctx, amhbi_t *num1, amhbi_t *num2);
 
-/* Divide by iterated subtraction; return the remainder */
-static amhbi_t * amhbi_rem_slow (amhbi_t *num1, amhbi_t *num2);
+/* Half of a number in the context's form; the modulus must be odd */
+static amhbi_t * amhbi_mont_half (amhbi_mont_t *ctx, amhbi_t *num);
 
+/* Converts num to the context's form */
+static amhbi_t * amhbi_mont_to (amhbi_mont_t *ctx, amhbi_t *num);
+
+/* Converts num back from the context's form */
+static amhbi_t * amhbi_mont_from (amhbi_mont_t *ctx, amhbi_t *num);
+
+/* Raise num, in the context's form, to the non-negative p power */
+static amhbi_t * amhbi_mont_pow (amhbi_mont_t *ctx, amhbi_t *num, amhbi_t *p);
+
+/* Destroys the given modular context */
+static void amhbi_mont_free (amhbi_mont_t *ctx);
+
+/* Inverse of num modulo 10^n; num must be coprime to 10 */
+static amhbi_t * amhbi_invmod_pow10 (amhbi_t *num, uint64_t n);
+
+/* Fills the table of small primes */
+static void amhbi_primes_init ();
+
+/* Sets rems to the remainders of the absolute value of num by each table prime */
+static void amhbi_rem_primes (amhbi_t *num, uint32_t *rems);
+
+/* Tests a job's share of a window's survivors for a probable prime */
+static void * amhbi_sieve_worker (void *arg);
+
+/* Strong probable prime test of the context's modulus, n - 1 = d * 2^s */
+static uint8_t amhbi_mr (amhbi_mont_t *ctx, amhbi_t *d, uint64_t s, amhbi_t *base);
+
+/* Strong Lucas probable prime test of the context's modulus */
+static uint8_t amhbi_lucas (amhbi_mont_t *ctx);
+
+/* Jacobi symbol (a / n) for an odd n */
+static int8_t amhbi_jacobi_word (int64_t a, amhbi_t *n);
+
+/* Returns the binary digits of the absolute value of num, least significant first */
+static uint8_t * amhbi_bits (amhbi_t *num, uint64_t *count);
+
+
+/* SplitMix64 output function */
+static uint64_t amhbi_rand_mix (uint64_t z);
+
+/* Returns the next word of the stream of state */
+static uint64_t amhbi_rand_next (amhbi_rand_t *state);
+
+/* Fills one run of digits of a random bigint */
+static void * amhbi_rand_worker (void *arg);
+
+
+/* Returns |num| as *count binary words, least significant first */
+static uint64_t * amhbi_to_words (amhbi_t *num, uint64_t *count);
+
+/* Writes num into words, splitting on pow[j] and below */
+static void amhbi_words_split (amhbi_t *num, uint64_t *words, amhbi_t **pow, uint64_t j);
+
+/* Returns the value of count binary words, least significant first */
+static amhbi_t * amhbi_from_words (uint64_t *words, uint64_t count);
+
+/* Joins count words into a bigint, splitting on pow[j] and below */
+static amhbi_t * amhbi_words_join (uint64_t *words, uint64_t count, amhbi_t **pow, uint64_t j);
+
+/* Returns |num| times or divided by 2^bits, for bits at most 32 */
+static amhbi_t * amhbi_shift_small (amhbi_t *num, uint8_t bits, uint8_t left, uint8_t *inexact);
+
+/* Applies the bitwise op &, | or ^ to num1 and num2 in two's complement */
+static amhbi_t * amhbi_bitwise (amhbi_t *num1, amhbi_t *num2, char op);
+
+/* Sum or difference of q1 and q2 */
+static amhbq_t * amhbq_addsub (amhbq_t *q1, amhbq_t *q2, uint8_t sub);
+
+/* Product of a / b and c / d, reduced by the cross gcds unless lazy */
+static amhbq_t * amhbq_muldiv (amhbi_t *a, amhbi_t *b, amhbi_t *c, amhbi_t *d, uint8_t lazy);
+
+/* Normalizes zero and reduces q if it must be */
+static void amhbq_settle (amhbq_t *q, uint8_t reduced);
+
+/* Inverse of an odd d not divisible by 5 modulo 10^8 */
+static uint64_t amhbi_inv_limb (uint64_t d);
+
+/* Exact quotient of num by d, coprime to 10 and below 10^8 */
+static amhbi_t * amhbi_divexact_limb (amhbi_t *num, uint64_t d);
+
+/* Exact quotient of num1 by num2, coprime to 10, of at most n digits */
+static amhbi_t * amhbi_divexact_basecase (amhbi_t *num1, amhbi_t *num2, uint64_t n);
+
+/* The same, a block of num2's length at a time */
+static amhbi_t * amhbi_divexact_blocks (amhbi_t *num1, amhbi_t *num2, uint64_t n);
+
+/* Uncached bodies of the operations the memo cache sits in front of */
+static amhbi_t * amhbi_pow_calc (amhbi_t *num, amhbi_t *p);
+static amhbi_t * amhbi_powm_calc (amhbi_t *num, amhbi_t *p, amhbi_t *mod);
+static amhbi_t * amhbi_quo_calc (amhbi_t *num1, amhbi_t *num2);
+static amhbi_t * amhbi_rem_calc (amhbi_t *num1, amhbi_t *num2);
+static amhbi_t * amhbi_gcd_calc (amhbi_t *num1, amhbi_t *num2);
+static amhbi_t * amhbi_sqrt_calc (amhbi_t *num);
+static amhbi_t * amhbi_nextprime_calc (amhbi_t *num);
+
+/* Hashes an operation and the contents of its operands */
+static uint64_t amhbi_cache_hash (amhbi_cache_op_t op, amhbi_t **args, uint8_t argc);
+
+/* Returns op of args, from the cache when it holds it */
+static amhbi_t * amhbi_cached (amhbi_cache_op_t op, amhbi_t **args, uint8_t argc);
+
+/* Unlinks an entry from its chain and the recency list and destroys it */
+static void amhbi_cache_drop (amhbi_cache_entry_t *entry);
+
+/* Computes op of args without the cache */
+static amhbi_t * amhbi_cache_calc (amhbi_cache_op_t op, amhbi_t **args);
+
+
+/* Adds the counters of src to dst */
+static void amhbi_instr_merge (amhbi_instr_t *dst, amhbi_instr_t *src);
+
+/* Writes count trace events, separating them with commas after the first */
+static void amhbi_instr_write (FILE *file, amhbi_event_t *events, uint64_t count, uint8_t *first);
+
+#ifdef AMHBI_INSTRUMENT
+/* Creates the key whose destructor retires thread blocks */
+static void amhbi_instr_key_init ();
+
+/* Returns the monotonic clock in nanoseconds */
+static uint64_t amhbi_instr_now ();
+
+/* Returns the instrumentation block of the calling thread, creating it */
+static amhbi_instr_thread_t * amhbi_instr_thread ();
+
+/* Folds an exiting thread's block into the retired totals */
+static void amhbi_instr_retire (void *arg);
+
+/* Adds one call of size to the counters of probe in the thread's block */
+static void amhbi_instr_add (amhbi_instr_thread_t *self, amhbi_probe_t probe, uint64_t size);
+
+/* Counts one call of probe without timing it */
+static void amhbi_instr_count (amhbi_probe_t probe, uint64_t size);
+
+/* Opens a span of probe */
+static amhbi_span_t amhbi_instr_begin (amhbi_probe_t probe, uint64_t size);
+
+/* Closes a span, recording it when tracing */
+static void amhbi_instr_end (amhbi_span_t *span);
+#endif
+
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,293 @@
+// bigint.hpp
+
+#ifndef AMHBI_HPP
+#define AMHBI_HPP
+
+#include <string>
+#include <ostream>
+#include <type_traits>
+#include "bigint.h"
+
+
+namespace amhbi {
+
+class integer;
+
+
+/*
+ * Expressions; sums and differences of integers and of products of two
+ * integers are kept unevaluated and folded into an accumulator when they
+ * are assigned, so only the result is allocated. Expressions hold
+ * references, so they must be used within the statement that makes them
+ */
+
+template <class E>
+struct expr
+{
+  const E &self () const { return static_cast<const E &>(*this); }
+};
+
+struct ref_expr : expr<ref_expr>
+{
+  const integer &a;
+  explicit ref_expr (const integer &a) : a(a) {}
+  void emit (amhbi_acc_t *acc, bool neg) const;
+};
+
+struct prod_expr : expr<prod_expr>
+{
+  const integer &a;
+  const integer &b;
+  prod_expr (const integer &a, const integer &b) : a(a), b(b) {}
+  void emit (amhbi_acc_t *acc, bool neg) const;
+};
+
+struct word_expr : expr<word_expr>
+{
+  uint64_t mag;
+  bool neg;
+  template <class T>
+  explicit word_expr (T val) : mag((std::is_signed<T>::value && val < 0) ? -(uint64_t)val : (uint64_t)val),
+    neg(std::is_signed<T>::value && val < 0) {}
+  void emit (amhbi_acc_t *acc, bool neg) const;
+};
+
+template <class L, class R, bool Sub>
+struct sum_expr : expr<sum_expr<L, R, Sub>>
+{
+  L l;
+  R r;
+  sum_expr (const L &l, const R &r) : l(l), r(r) {}
+  void emit (amhbi_acc_t *acc, bool neg) const { l.emit(acc, neg); r.emit(acc, neg ^ Sub); }
+};
+
+template <class E>
+struct neg_expr : expr<neg_expr<E>>
+{
+  E e;
+  explicit neg_expr (const E &e) : e(e) {}
+  void emit (amhbi_acc_t *acc, bool neg) const { e.emit(acc, !neg); }
+};
+
+
+/*
+ * Integer; owns one bigint, freed when it goes out of scope. Copies share
+ * digits until either is written, and moves take the bigint outright
+ */
+
+class integer
+{
+  amhbi_t *p;
+
+  // Per-thread accumulator reused by every evaluation, whatever the shape
+  // of the expression; it lives outside the template so there is only one.
+  // Oversized columns are dropped so one huge expression doesn't slow every
+  // later reset
+  struct scratch
+  {
+    amhbi_acc_t *acc = amhbi_acc_init();
+    ~scratch () { amhbi_acc_free(acc); }
+  };
+
+  static amhbi_acc_t *&
+  scratch_acc ()
+  {
+    static thread_local scratch s;
+    return s.acc;
+  }
+
+  template <class E>
+  static amhbi_t *
+  eval (const expr<E> &e)
+  {
+    amhbi_acc_t *&acc = scratch_acc();
+    amhbi_acc_reset(acc);
+    e.self().emit(acc, false);
+    amhbi_t *res = amhbi_acc_get(acc);
+    if (acc->size > 4096) {
+      amhbi_acc_free(acc);
+      acc = amhbi_acc_init();
+    }
+    return res;
+  }
+
+  static amhbi_t *eval (const expr<prod_expr> &e) { return amhbi_mult(e.self().a.p, e.self().b.p); }
+
+  static amhbi_t *eval (const expr<ref_expr> &e) { return amhbi_init_cpy(e.self().a.p); }
+
+  static amhbi_t *
+  eval (const expr<word_expr> &e)
+  {
+    amhbi_t *res = amhbi_init_uint(e.self().mag);
+    if (e.self().neg) res->sign = 1;
+    return res;
+  }
+
+  void reset (amhbi_t *num) { if (p) amhbi_free(1, p); p = num; }
+
+public:
+  integer () : p(amhbi_init_zero()) {}
+  integer (int val) : p(amhbi_init_int(val)) {}
+  integer (long val) : p(amhbi_init_int(val)) {}
+  integer (long long val) : p(amhbi_init_int(val)) {}
+  integer (unsigned long val) : p(amhbi_init_uint(val)) {}
+  integer (unsigned long long val) : p(amhbi_init_uint(val)) {}
+  explicit integer (const char *str) : p(amhbi_init_str(const_cast<char *>(str))) {}
+  explicit integer (const std::string &str) : integer(str.c_str()) {}
+
+  /* Takes ownership of num */
+  static integer adopt (amhbi_t *num) { integer res(nullptr); res.p = num; return res; }
+
+  integer (const integer &other) : p(amhbi_init_cpy(other.p)) {}
+  integer (integer &&other) noexcept : p(other.p) { other.p = nullptr; }
+
+  template <class E>
+  integer (const expr<E> &e) : p(eval(e)) {}
+
+  ~integer () { if (p) amhbi_free(1, p); }
+
+  integer &operator= (const integer &other) { if (this != &other) reset(amhbi_init_cpy(other.p)); return *this; }
+  integer &operator= (integer &&other) noexcept { if (this != &other) { reset(other.p); other.p = nullptr; } return *this; }
+
+  template <class E>
+  integer &operator= (const expr<E> &e) { reset(eval(e)); return *this; }
+
+  /* Returns the bigint, still owned by this integer */
+  amhbi_t *get () const { return p; }
+
+  /* Gives up ownership of the bigint */
+  amhbi_t *release () { amhbi_t *res = p; p = nullptr; return res; }
+
+  std::string
+  str () const
+  {
+    char *s = amhbi_to_str(p);
+    std::string res(s);
+    free(s);
+    return res;
+  }
+
+  // Products are added to or taken from the destination in place
+  integer &operator+= (const expr<prod_expr> &e) { amhbi_addmul(p, e.self().a.p, e.self().b.p); return *this; }
+  integer &operator-= (const expr<prod_expr> &e) { amhbi_submul(p, e.self().a.p, e.self().b.p); return *this; }
+  integer &operator+= (const integer &b) { reset(amhbi_add(p, b.p)); return *this; }
+  integer &operator-= (const integer &b) { reset(amhbi_subt(p, b.p)); return *this; }
+
+  template <class E>
+  integer &operator+= (const expr<E> &e) { return *this = sum_expr<ref_expr, E, false>(ref_expr(*this), e.self()); }
+
+  template <class E>
+  integer &operator-= (const expr<E> &e) { return *this = sum_expr<ref_expr, E, true>(ref_expr(*this), e.self()); }
+
+  integer &operator*= (const integer &b) { reset(amhbi_mult(p, b.p)); return *this; }
+  integer &operator/= (const integer &b) { reset(amhbi_quo(p, b.p)); return *this; }
+  integer &operator%= (const integer &b) { reset(amhbi_rem(p, b.p)); return *this; }
+
+  friend integer operator/ (const integer &a, const integer &b) { return adopt(amhbi_quo(a.p, b.p)); }
+  friend integer operator% (const integer &a, const integer &b) { return adopt(amhbi_rem(a.p, b.p)); }
+
+  friend int cmp (const integer &a, const integer &b) { return amhbi_cmp(a.p, b.p); }
+
+  friend struct ref_expr;
+  friend struct prod_expr;
+
+private:
+  explicit integer (std::nullptr_t) : p(nullptr) {}
+};
+
+
+inline void
+ref_expr::emit (amhbi_acc_t *acc, bool neg) const
+{
+  if (neg) amhbi_acc_sub(acc, a.p);
+  else amhbi_acc_add(acc, a.p);
+}
+
+
+inline void
+word_expr::emit (amhbi_acc_t *acc, bool neg) const
+{
+  // Magnitudes past INT64_MAX go in as up to three words
+  int64_t sign = (this->neg ^ neg) ? -1 : 1;
+  uint64_t rest = mag;
+  while (rest > INT64_MAX) {
+    amhbi_acc_add_int(acc, sign * INT64_MAX);
+    rest -= INT64_MAX;
+  }
+  amhbi_acc_add_int(acc, sign * (int64_t)rest);
+}
+
+
+inline void
+prod_expr::emit (amhbi_acc_t *acc, bool neg) const
+{
+  if (neg) amhbi_acc_submul(acc, a.p, b.p);
+  else amhbi_acc_addmul(acc, a.p, b.p);
+}
+
+
+/*
+ * Operators; integers enter expressions by reference and built-in integers
+ * by value, products of anything but two integers are evaluated on the spot
+ */
+
+template <class T> struct is_operand
+  : std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value> {};
+template <> struct is_operand<integer> : std::true_type {};
+template <> struct is_operand<ref_expr> : std::true_type {};
+template <> struct is_operand<prod_expr> : std::true_type {};
+template <class L, class R, bool S> struct is_operand<sum_expr<L, R, S>> : std::true_type {};
+template <class E> struct is_operand<neg_expr<E>> : std::true_type {};
+
+inline ref_expr as_expr (const integer &a) { return ref_expr(a); }
+template <class T, class = std::enable_if_t<std::is_integral<T>::value>>
+inline word_expr as_expr (T val) { return word_expr(val); }
+template <class E> inline const E &as_expr (const expr<E> &e) { return e.self(); }
+
+template <class T>
+using expr_of = std::decay_t<decltype(as_expr(std::declval<const T &>()))>;
+
+template <class A, class B, class = std::enable_if_t<is_operand<A>::value && is_operand<B>::value>>
+inline sum_expr<expr_of<A>, expr_of<B>, false>
+operator+ (const A &a, const B &b)
+{
+  return sum_expr<expr_of<A>, expr_of<B>, false>(as_expr(a), as_expr(b));
+}
+
+template <class A, class B, class = std::enable_if_t<is_operand<A>::value && is_operand<B>::value>>
+inline sum_expr<expr_of<A>, expr_of<B>, true>
+operator- (const A &a, const B &b)
+{
+  return sum_expr<expr_of<A>, expr_of<B>, true>(as_expr(a), as_expr(b));
+}
+
+template <class A, class = std::enable_if_t<is_operand<A>::value>>
+inline neg_expr<expr_of<A>>
+operator- (const A &a)
+{
+  return neg_expr<expr_of<A>>(as_expr(a));
+}
+
+inline prod_expr operator* (const integer &a, const integer &b) { return prod_expr(a, b); }
+
+template <class A, class B, class = std::enable_if_t<is_operand<A>::value && is_operand<B>::value &&
+  !(std::is_same<A, integer>::value && std::is_same<B, integer>::value)>>
+inline integer
+operator* (const A &a, const B &b)
+{
+  integer x(as_expr(a)), y(as_expr(b));
+  return integer::adopt(amhbi_mult(x.get(), y.get()));
+}
+
+inline bool operator== (const integer &a, const integer &b) { return cmp(a, b) == 0; }
+inline bool operator!= (const integer &a, const integer &b) { return cmp(a, b) != 0; }
+inline bool operator< (const integer &a, const integer &b) { return cmp(a, b) < 0; }
+inline bool operator<= (const integer &a, const integer &b) { return cmp(a, b) <= 0; }
+inline bool operator> (const integer &a, const integer &b) { return cmp(a, b) > 0; }
+inline bool operator>= (const integer &a, const integer &b) { return cmp(a, b) >= 0; }
+
+inline std::ostream &operator<< (std::ostream &out, const integer &a) { return out << a.str(); }
+
+}
+
+#endif
@@ -0,0 +1,292 @@
+// bigint_fixed.hpp
+
+#ifndef AMHBI_FIXED_HPP
+#define AMHBI_FIXED_HPP
+
+#include "bigint.h"
+
+
+namespace amhbi {
+
+/*
+ * Fixed-width unsigned integers; Bits / 64 binary words stored inline, least
+ * significant first. Arithmetic wraps around modulo 2^Bits, and every loop
+ * runs a constant number of times so the compiler unrolls it per width
+ */
+
+template <unsigned Bits>
+class fixed
+{
+  static_assert(Bits > 0 && Bits % 64 == 0, "width must be a multiple of 64 bits");
+
+  typedef unsigned __int128 wide_t;
+
+public:
+  static constexpr unsigned words = Bits / 64;
+
+  uint64_t w[words];
+
+  constexpr fixed () : w{} {}
+
+  constexpr fixed (uint64_t val) : w{} { w[0] = val; }
+
+  /* Converts num modulo 2^Bits; negative values wrap to their complement */
+  static fixed
+  from_bigint (const amhbi_t *num)
+  {
+    // Nineteen decimal digits at a time: res = res * 10^k + chunk
+    fixed res;
+    uint64_t i = 0;
+    while (i < num->length) {
+      uint64_t k = (num->length - i < 19) ? num->length - i : 19;
+      uint64_t chunk = 0, scale = 1;
+      uint64_t j; for (j = 0; j < k; j++, i++) {
+        chunk = chunk * 10 + (num->digits[i] - '0');
+        scale *= 10;
+      }
+      res.mul_add(scale, chunk);
+    }
+    return (num->sign) ? -res : res;
+  }
+
+  /* Returns a new bigint holding the value */
+  amhbi_t *
+  to_bigint () const
+  {
+    // Peel off nineteen digits at a time, least significant first
+    char str[words * 20 + 20];
+    char *end = &str[sizeof(str) - 1];
+    *end = 0;
+    fixed rest = *this;
+    char *pos = end;
+    do {
+      uint64_t chunk = rest.div_small(10000000000000000000ULL);
+      uint64_t j; for (j = 0; j < 19; j++) {
+        *--pos = '0' + chunk % 10;
+        chunk /= 10;
+      }
+    } while (!rest.is_zero());
+    while (pos < end - 1 && *pos == '0') pos++;
+    return amhbi_init_str(pos);
+  }
+
+  constexpr bool
+  is_zero () const
+  {
+    uint64_t any = 0;
+    #pragma GCC unroll 64
+    for (unsigned i = 0; i < words; i++) any |= w[i];
+    return !any;
+  }
+
+  /* Returns -1, 0 or 1 as a is less than, equal to or greater than b */
+  static constexpr int
+  cmp (const fixed &a, const fixed &b)
+  {
+    #pragma GCC unroll 64
+    for (unsigned k = 1; k <= words; k++) {
+      if (a.w[words - k] != b.w[words - k]) return (a.w[words - k] < b.w[words - k]) ? -1 : 1;
+    }
+    return 0;
+  }
+
+  /* Sets res to a + b and returns the carry out */
+  static constexpr uint64_t
+  add (fixed &res, const fixed &a, const fixed &b)
+  {
+    uint64_t carry = 0;
+    #pragma GCC unroll 64
+    for (unsigned i = 0; i < words; i++) {
+      wide_t s = (wide_t)a.w[i] + b.w[i] + carry;
+      res.w[i] = (uint64_t)s;
+      carry = (uint64_t)(s >> 64);
+    }
+    return carry;
+  }
+
+  /* Sets res to a - b and returns the borrow out */
+  static constexpr uint64_t
+  sub (fixed &res, const fixed &a, const fixed &b)
+  {
+    uint64_t borrow = 0;
+    #pragma GCC unroll 64
+    for (unsigned i = 0; i < words; i++) {
+      wide_t d = (wide_t)a.w[i] - b.w[i] - borrow;
+      res.w[i] = (uint64_t)d;
+      borrow = (uint64_t)(d >> 64) & 1;
+    }
+    return borrow;
+  }
+
+  /* Returns the low Bits bits of a * b; columns past the width are skipped */
+  static constexpr fixed
+  mul (const fixed &a, const fixed &b)
+  {
+    fixed res;
+    for (unsigned i = 0; i < words; i++) {
+      uint64_t carry = 0;
+      #pragma GCC unroll 64
+      for (unsigned j = 0; i + j < words; j++) {
+        wide_t p = (wide_t)a.w[i] * b.w[j] + res.w[i + j] + carry;
+        res.w[i + j] = (uint64_t)p;
+        carry = (uint64_t)(p >> 64);
+      }
+    }
+    return res;
+  }
+
+  /* Returns the full 2 * Bits bit product of a and b */
+  static constexpr fixed<2 * Bits>
+  mul_full (const fixed &a, const fixed &b)
+  {
+    fixed<2 * Bits> res;
+    for (unsigned i = 0; i < words; i++) {
+      uint64_t carry = 0;
+      #pragma GCC unroll 64
+      for (unsigned j = 0; j < words; j++) {
+        wide_t p = (wide_t)a.w[i] * b.w[j] + res.w[i + j] + carry;
+        res.w[i + j] = (uint64_t)p;
+        carry = (uint64_t)(p >> 64);
+      }
+      res.w[i + words] = carry;
+    }
+    return res;
+  }
+
+  /* Sets quo and rem to the quotient and remainder of a by b; b must be non-zero */
+  static constexpr void
+  divmod (const fixed &a, const fixed &b, fixed &quo, fixed &rem)
+  {
+    // Significant words of the divisor
+    unsigned n = words;
+    while (n > 0 && !b.w[n - 1]) n--;
+    assert(n);
+    fixed q, r;
+
+    // One word divisors need a single pass of short division
+    if (n == 1) {
+      q = a;
+      r.w[0] = q.div_small(b.w[0]);
+      quo = q;
+      rem = r;
+      return;
+    }
+
+    // Knuth's algorithm D; shift so the divisor's top word has its high bit set
+    unsigned s = __builtin_clzll(b.w[n - 1]);
+    uint64_t v[words] = {};
+    uint64_t u[words + 1] = {};
+    for (unsigned i = n; i-- > 0;) {
+      v[i] = (b.w[i] << s) | ((s && i) ? b.w[i - 1] >> (64 - s) : 0);
+    }
+    u[words] = (s) ? a.w[words - 1] >> (64 - s) : 0;
+    for (unsigned i = words; i-- > 0;) {
+      u[i] = (a.w[i] << s) | ((s && i) ? a.w[i - 1] >> (64 - s) : 0);
+    }
+
+    for (unsigned j = words - n + 1; j-- > 0;) {
+      // Estimate the quotient word from the top two words, at most two too big
+      wide_t top = ((wide_t)u[j + n] << 64) | u[j + n - 1];
+      wide_t qhat = top / v[n - 1];
+      wide_t rhat = top % v[n - 1];
+      while ((qhat >> 64) || qhat * v[n - 2] > ((rhat << 64) | u[j + n - 2])) {
+        qhat--;
+        rhat += v[n - 1];
+        if (rhat >> 64) break;
+      }
+
+      // Subtract qhat * v from the window of u
+      uint64_t carry = 0, borrow = 0;
+      for (unsigned i = 0; i < n; i++) {
+        wide_t p = qhat * v[i] + carry;
+        carry = (uint64_t)(p >> 64);
+        wide_t d = (wide_t)u[i + j] - (uint64_t)p - borrow;
+        u[i + j] = (uint64_t)d;
+        borrow = (uint64_t)(d >> 64) & 1;
+      }
+      wide_t d = (wide_t)u[j + n] - carry - borrow;
+      u[j + n] = (uint64_t)d;
+
+      // Went negative; the estimate was one too big, so add v back
+      if ((d >> 64) & 1) {
+        qhat--;
+        carry = 0;
+        for (unsigned i = 0; i < n; i++) {
+          wide_t t = (wide_t)u[i + j] + v[i] + carry;
+          u[i + j] = (uint64_t)t;
+          carry = (uint64_t)(t >> 64);
+        }
+        u[j + n] += carry;
+      }
+      q.w[j] = (uint64_t)qhat;
+    }
+
+    // Shift the remainder back down
+    for (unsigned i = 0; i < n; i++) {
+      r.w[i] = (u[i] >> s) | ((s) ? u[i + 1] << (64 - s) : 0);
+    }
+    quo = q;
+    rem = r;
+  }
+
+  /* Divides in place by a single word d and returns the remainder */
+  constexpr uint64_t
+  div_small (uint64_t d)
+  {
+    uint64_t r = 0;
+    #pragma GCC unroll 64
+    for (unsigned k = 1; k <= words; k++) {
+      wide_t cur = ((wide_t)r << 64) | w[words - k];
+      w[words - k] = (uint64_t)(cur / d);
+      r = (uint64_t)(cur % d);
+    }
+    return r;
+  }
+
+  /* Sets the value to value * m + a */
+  constexpr void
+  mul_add (uint64_t m, uint64_t a)
+  {
+    uint64_t carry = a;
+    #pragma GCC unroll 64
+    for (unsigned i = 0; i < words; i++) {
+      wide_t p = (wide_t)w[i] * m + carry;
+      w[i] = (uint64_t)p;
+      carry = (uint64_t)(p >> 64);
+    }
+  }
+
+  constexpr fixed operator+ (const fixed &b) const { fixed r; add(r, *this, b); return r; }
+  constexpr fixed operator- (const fixed &b) const { fixed r; sub(r, *this, b); return r; }
+  constexpr fixed operator- () const { fixed r; sub(r, fixed(), *this); return r; }
+  constexpr fixed operator* (const fixed &b) const { return mul(*this, b); }
+  constexpr fixed operator/ (const fixed &b) const { fixed q, r; divmod(*this, b, q, r); return q; }
+  constexpr fixed operator% (const fixed &b) const { fixed q, r; divmod(*this, b, q, r); return r; }
+
+  constexpr fixed &operator+= (const fixed &b) { add(*this, *this, b); return *this; }
+  constexpr fixed &operator-= (const fixed &b) { sub(*this, *this, b); return *this; }
+  constexpr fixed &operator*= (const fixed &b) { return *this = mul(*this, b); }
+  constexpr fixed &operator/= (const fixed &b) { return *this = *this / b; }
+  constexpr fixed &operator%= (const fixed &b) { return *this = *this % b; }
+
+  constexpr bool operator== (const fixed &b) const { return cmp(*this, b) == 0; }
+  constexpr bool operator!= (const fixed &b) const { return cmp(*this, b) != 0; }
+  constexpr bool operator< (const fixed &b) const { return cmp(*this, b) < 0; }
+  constexpr bool operator<= (const fixed &b) const { return cmp(*this, b) <= 0; }
+  constexpr bool operator> (const fixed &b) const { return cmp(*this, b) > 0; }
+  constexpr bool operator>= (const fixed &b) const { return cmp(*this, b) >= 0; }
+};
+
+
+/*
+ * Common widths
+ */
+
+typedef fixed<256> fixed256;
+typedef fixed<512> fixed512;
+typedef fixed<1024> fixed1024;
+typedef fixed<4096> fixed4096;
+
+}
+
+#endif
@@ -1,11 +1,427 @@
 //main.c
-//메인함수 
+//메인함수; 인자가 없으면 예제 연산, --check 면 검사, 그 밖에는 한 줄에 한 식씩 계산하는 스트리밍 모드
 
 #include "bigint.h"
 
 
-int 
-main()
+/*
+ * 스트리밍 모드; 읽기와 파싱, 계산, 출력이 각자 스레드에서 돌고 줄 묶음이
+ * 큐를 따라 넘어간다. 다 쓴 묶음은 버퍼째로 다시 읽기 스레드에 돌아온다.
+ * STREAM_KEEP 자리까지의 결과는 묶음에 남아 계산 스레드의 여분 목록으로
+ * 돌아가 숫자를 읽을 때 다시 쓰이고, 여분은 STREAM_SPARE개까지 둔다.
+ * 결과가 STREAM_POW_DIGITS 자리를 넘을 거듭제곱은 오류
+ */
+
+#define STREAM_BATCH 4096
+#define STREAM_POOL 4
+#define STREAM_KEEP 4096
+#define STREAM_SPARE 4096
+#define STREAM_POW_DIGITS 10000000
+
+typedef struct
+{
+  char op;
+  uint64_t num;
+} stream_tok_t;
+
+typedef struct
+{
+  // 한 줄씩: 토큰 범위와 결과 (NULL이면 오류)
+  uint64_t lines;
+  uint64_t *first;
+  uint8_t *bad;
+  amhbi_t **res;
+
+  // 출력하고 남겨 둔 결과 수; 계산 스레드가 여분으로 가져간다
+  uint64_t kept;
+
+  // 후위식 토큰과 숫자 문자열
+  stream_tok_t *toks;
+  uint64_t ntoks;
+  uint64_t tokcap;
+  char *nums;
+  uint64_t nnums;
+  uint64_t numcap;
+  uint8_t last;
+} stream_batch_t;
+
+typedef struct
+{
+  stream_batch_t *items[STREAM_POOL + 1];
+  uint64_t head;
+  uint64_t count;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} stream_queue_t;
+
+typedef struct
+{
+  stream_queue_t free;
+  stream_queue_t parsed;
+  stream_queue_t done;
+  FILE *in;
+  FILE *out;
+  uint8_t rpn;
+} stream_t;
+
+
+static void
+stream_push (stream_queue_t *q, stream_batch_t *b)
+{
+  pthread_mutex_lock(&q->lock);
+  q->items[(q->head + q->count++) % (STREAM_POOL + 1)] = b;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->lock);
+}
+
+
+static stream_batch_t *
+stream_pop (stream_queue_t *q)
+{
+  pthread_mutex_lock(&q->lock);
+  while (!q->count) pthread_cond_wait(&q->cond, &q->lock);
+  stream_batch_t *b = q->items[q->head];
+  q->head = (q->head + 1) % (STREAM_POOL + 1);
+  q->count--;
+  pthread_mutex_unlock(&q->lock);
+  return b;
+}
+
+
+static void
+stream_tok (stream_batch_t *b, char op, const char *num, uint64_t len)
+{
+  if (b->ntoks == b->tokcap) {
+    b->tokcap *= 2;
+    b->toks = realloc(b->toks, b->tokcap * sizeof(stream_tok_t));
+    assert(b->toks);
+  }
+  b->toks[b->ntoks].op = op;
+  b->toks[b->ntoks].num = b->nnums;
+  b->ntoks++;
+  if (!num) return;
+
+  // 숫자는 0으로 끝나는 문자열로 복사해 둔다
+  if (b->nnums + len + 1 > b->numcap) {
+    while (b->nnums + len + 1 > b->numcap) b->numcap *= 2;
+    b->nums = realloc(b->nums, b->numcap);
+    assert(b->nums);
+  }
+  memcpy(&b->nums[b->nnums], num, len);
+  b->nums[b->nnums + len] = 0;
+  b->nnums += len + 1;
+}
+
+
+static int
+stream_prec (char op)
+{
+  switch (op) {
+    case '+': case '-': return 1;
+    case '*': case '/': case '%': return 2;
+    case '~': return 3;
+    case '^': return 4;
+    default: return 0;
+  }
+}
+
+
+static uint8_t
+stream_parse (stream_batch_t *b, char *line, char *ops, uint8_t rpn)
+{
+  // 후위식으로 바꾸면서 스택 깊이를 세어 잘못된 식을 미리 걸러낸다;
+  // ops는 줄 길이만큼의 연산자 스택
+  uint64_t nops = 0;
+  int64_t depth = 0;
+  uint8_t operand = 1;
+  char *p = line;
+  while (1) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if (!*p) break;
+
+    // 숫자; 후위식에서는 바로 붙은 '-'도 숫자의 일부
+    char *start = p;
+    if (rpn && *p == '-' && isdigit((unsigned char)p[1])) p++;
+    if (isdigit((unsigned char)*p)) {
+      while (isdigit((unsigned char)*p)) p++;
+      if (!rpn && !operand) return 0;
+      stream_tok(b, 'n', start, p - start);
+      depth++;
+      operand = 0;
+      continue;
+    }
+
+    char op = *p++;
+    if (rpn) {
+      if (!stream_prec(op) || op == '~') return 0;
+      if (depth < 2) return 0;
+      stream_tok(b, op, NULL, 0);
+      depth--;
+      continue;
+    }
+
+    // 중위식; 피연산자 자리에 온 '-'는 부호
+    if (op == '(') {
+      if (!operand) return 0;
+      ops[nops++] = op;
+    }
+    else if (op == ')') {
+      if (operand) return 0;
+      while (nops && ops[nops - 1] != '(') {
+        char top = ops[--nops];
+        stream_tok(b, top, NULL, 0);
+        depth -= (top != '~');
+      }
+      if (!nops) return 0;
+      nops--;
+    }
+    else if (operand && op == '-') {
+      ops[nops++] = '~';
+    }
+    else if (stream_prec(op) && op != '~' && !operand) {
+      // '^'만 오른쪽부터 묶는다
+      while (nops && ops[nops - 1] != '(' && (stream_prec(ops[nops - 1]) > stream_prec(op) ||
+        (stream_prec(ops[nops - 1]) == stream_prec(op) && op != '^'))) {
+        char top = ops[--nops];
+        stream_tok(b, top, NULL, 0);
+        depth -= (top != '~');
+      }
+      ops[nops++] = op;
+      operand = 1;
+    }
+    else return 0;
+  }
+  if (!rpn) {
+    if (operand) return 0;
+    while (nops) {
+      char top = ops[--nops];
+      if (top == '(') return 0;
+      stream_tok(b, top, NULL, 0);
+      depth -= (top != '~');
+    }
+  }
+  return depth == 1;
+}
+
+
+static void
+stream_drop (amhbi_t **spare, uint64_t *nspare, amhbi_t *num)
+{
+  // 길지 않은 값만 여분으로 두고 나머지는 해제한다
+  if (*nspare < STREAM_SPARE && amhbi_size(num) <= STREAM_KEEP) spare[(*nspare)++] = num;
+  else amhbi_free(1, num);
+}
+
+
+static uint8_t
+stream_pow_ok (amhbi_t *x, amhbi_t *y)
+{
+  // 0, 1, -1은 지수가 커도 그대로다
+  if (amhbi_size(x) == 1 && x->digits[0] < '2') return 1;
+  if (amhbi_size(y) > 18) return 0;
+
+  // 결과는 지수 * log10|x| 자리쯤이다; 앞의 15자리로 어림한다
+  uint64_t k = (amhbi_size(x) < 15) ? amhbi_size(x) : 15;
+  double lead = 0;
+  uint64_t i; for (i = 0; i < k; i++) lead = lead * 10 + (x->digits[i] - '0');
+  double digits = (double)amhbi_to_uint(y) * (amhbi_size(x) - k + log10(lead));
+  return digits <= STREAM_POW_DIGITS;
+}
+
+
+static void *
+stream_eval (void *arg)
+{
+  stream_t *s = arg;
+  amhbi_t **stack = NULL;
+  uint64_t cap = 0;
+  amhbi_t **spare = malloc(STREAM_SPARE * sizeof(amhbi_t *));
+  assert(spare);
+  uint64_t nspare = 0;
+  while (1) {
+    stream_batch_t *b = stream_pop(&s->parsed);
+    uint64_t i; for (i = 0; i < b->kept; i++) {
+      if (b->res[i]) stream_drop(spare, &nspare, b->res[i]);
+    }
+    b->kept = 0;
+    for (i = 0; i < b->lines; i++) {
+      b->res[i] = NULL;
+      if (b->bad[i]) continue;
+
+      // 토큰 수만큼이면 스택이 넘치지 않는다
+      uint64_t end = (i + 1 < b->lines) ? b->first[i + 1] : b->ntoks;
+      if (end - b->first[i] > cap) {
+        cap = end - b->first[i];
+        stack = realloc(stack, cap * sizeof(amhbi_t *));
+        assert(stack);
+      }
+      uint64_t n = 0;
+      uint8_t ok = 1;
+      uint64_t t; for (t = b->first[i]; t < end && ok; t++) {
+        stream_tok_t *tok = &b->toks[t];
+        if (tok->op == 'n') {
+          char *num = &b->nums[tok->num];
+          stack[n++] = (nspare) ? amhbi_set_str(spare[--nspare], num) : amhbi_init_str(num);
+          continue;
+        }
+        if (tok->op == '~') {
+          amhbi_t *neg = amhbi_negate(stack[n - 1]);
+          stream_drop(spare, &nspare, stack[n - 1]);
+          stack[n - 1] = neg;
+          continue;
+        }
+
+        // 0으로 나누기, 음수 지수, 너무 큰 거듭제곱은 오류
+        amhbi_t *x = stack[n - 2], *y = stack[n - 1];
+        amhbi_t *res = NULL;
+        switch (tok->op) {
+          case '+': res = amhbi_add(x, y); break;
+          case '-': res = amhbi_subt(x, y); break;
+          case '*': res = amhbi_mult(x, y); break;
+          case '/': if (!amhbi_iszero(y)) res = amhbi_quo(x, y); break;
+          case '%': if (!amhbi_iszero(y)) res = amhbi_rem(x, y); break;
+          case '^': if (!amhbi_sign(y) && stream_pow_ok(x, y)) res = amhbi_pow(x, y); break;
+        }
+        stream_drop(spare, &nspare, x);
+        stream_drop(spare, &nspare, y);
+        n -= 2;
+        if (res) stack[n++] = res;
+        else ok = 0;
+      }
+      if (ok) b->res[i] = stack[--n];
+      while (n) stream_drop(spare, &nspare, stack[--n]);
+    }
+    // 넘긴 뒤에는 묶음을 건드리지 않는다
+    uint8_t last = b->last;
+    stream_push(&s->done, b);
+    if (last) break;
+  }
+  while (nspare) amhbi_free(1, spare[--nspare]);
+  free(spare);
+  free(stack);
+  return NULL;
+}
+
+
+static void *
+stream_write (void *arg)
+{
+  stream_t *s = arg;
+  while (1) {
+    stream_batch_t *b = stream_pop(&s->done);
+    uint64_t i; for (i = 0; i < b->lines; i++) {
+      if (!b->res[i]) {
+        fputs((b->bad[i] == 2) ? "\n" : "error\n", s->out);
+        continue;
+      }
+      // 자리를 바로 쓰고, 짧은 결과는 계산 스레드에 돌려준다
+      amhbi_t *res = b->res[i];
+      if (res->sign) fputc('-', s->out);
+      fwrite(res->digits, 1, amhbi_size(res), s->out);
+      fputc('\n', s->out);
+      if (amhbi_size(res) > STREAM_KEEP) {
+        amhbi_free(1, res);
+        b->res[i] = NULL;
+      }
+    }
+    b->kept = b->lines;
+    uint8_t last = b->last;
+    stream_push(&s->free, b);
+    if (last) break;
+  }
+  fflush(s->out);
+  return NULL;
+}
+
+
+static int
+stream (FILE *in, uint8_t rpn)
+{
+  stream_t s;
+  memset(&s, 0, sizeof(s));
+  s.in = in;
+  s.out = stdout;
+  s.rpn = rpn;
+  stream_queue_t *queues[3] = {&s.free, &s.parsed, &s.done};
+  int k; for (k = 0; k < 3; k++) {
+    pthread_mutex_init(&queues[k]->lock, NULL);
+    pthread_cond_init(&queues[k]->cond, NULL);
+  }
+
+  // 묶음은 처음에 한 번만 만들고 계속 돌려 쓴다
+  stream_batch_t pool[STREAM_POOL];
+  for (k = 0; k < STREAM_POOL; k++) {
+    stream_batch_t *b = &pool[k];
+    memset(b, 0, sizeof(*b));
+    b->first = malloc(STREAM_BATCH * sizeof(uint64_t));
+    b->bad = malloc(STREAM_BATCH);
+    b->res = malloc(STREAM_BATCH * sizeof(amhbi_t *));
+    b->tokcap = 4 * STREAM_BATCH;
+    b->toks = malloc(b->tokcap * sizeof(stream_tok_t));
+    b->numcap = 16 * STREAM_BATCH;
+    b->nums = malloc(b->numcap);
+    assert(b->first && b->bad && b->res && b->toks && b->nums);
+    stream_push(&s.free, b);
+  }
+
+  static char buf[1 << 20];
+  setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+  pthread_t evaluator, writer;
+  int ok = pthread_create(&evaluator, NULL, stream_eval, &s);
+  assert(!ok);
+  ok = pthread_create(&writer, NULL, stream_write, &s);
+  assert(!ok);
+
+  // 이 스레드는 읽고 파싱한다
+  char *line = NULL, *ops = NULL;
+  size_t len = 0, opscap = 0;
+  uint8_t last = 0;
+  while (!last) {
+    stream_batch_t *b = stream_pop(&s.free);
+    b->lines = b->ntoks = b->nnums = 0;
+    while (b->lines < STREAM_BATCH) {
+      ssize_t n = getline(&line, &len, in);
+      if (n < 0) {
+        last = 1;
+        break;
+      }
+      if ((size_t)n > opscap) {
+        opscap = n;
+        ops = realloc(ops, opscap);
+        assert(ops);
+      }
+      b->first[b->lines] = b->ntoks;
+      char *p = line;
+      while (isspace((unsigned char)*p)) p++;
+      b->bad[b->lines] = (*p) ? !stream_parse(b, line, ops, rpn) : 2;
+      if (b->bad[b->lines]) b->ntoks = b->first[b->lines];
+      b->lines++;
+    }
+    b->last = last;
+    stream_push(&s.parsed, b);
+  }
+  free(line);
+  free(ops);
+
+  pthread_join(evaluator, NULL);
+  pthread_join(writer, NULL);
+  for (k = 0; k < STREAM_POOL; k++) {
+    stream_batch_t *b = &pool[k];
+    uint64_t i; for (i = 0; i < b->kept; i++) {
+      if (b->res[i]) amhbi_free(1, b->res[i]);
+    }
+    free(b->first); free(b->bad); free(b->res); free(b->toks); free(b->nums);
+  }
+  for (k = 0; k < 3; k++) {
+    pthread_mutex_destroy(&queues[k]->lock);
+    pthread_cond_destroy(&queues[k]->cond);
+  }
+  return 0;
+}
+
+
+static int
+demo ()
 {
   // 사용할 bigint 만들기
   amhbi_t *one              = amhbi_init_int(1);
@@ -22,12 +438,135 @@ main()
   amhbi_t *result5 = amhbi_pow(morethan64bits, nine);
   amhbi_free(5, one, negativetwo, fourquadrillion, morethan64bits, nine);
 
-  // 전환과 결과보이기
-  printf("result1 = %s\n", amhbi_to_str(result1));
-  printf("result2 = %s\n", amhbi_to_str(result2));
-  printf("result3 = %s\n", amhbi_to_str(result3));
-  printf("result4 = %s\n", amhbi_to_str(result4));
-  printf("result5 = %s\n", amhbi_to_str(result5));
+  // 전환과 결과보이기; 문자열도 해제한다
+  amhbi_t *results[5] = {result1, result2, result3, result4, result5};
+  int i; for (i = 0; i < 5; i++) {
+    char *str = amhbi_to_str(results[i]);
+    printf("result%d = %s\n", i + 1, str);
+    free(str);
+  }
 
   amhbi_free(5, result1, result2, result3, result4, result5);
+  return 0;
+}
+
+
+/*
+ * 검사 모드; 답을 따로 아는 경우로 AMHBI_GCD_HALF 자리를 넘는 반-gcd와
+ * 약분하지 않은 게으른 유리수의 부호 섞인 비교를 확인한다
+ */
+
+static int
+check_gcd (const char *name, amhbi_t *a, amhbi_t *b, amhbi_t *want)
+{
+  // 두 순서 모두 같은 답이어야 한다
+  amhbi_t *g1 = amhbi_gcd(a, b);
+  amhbi_t *g2 = amhbi_gcd(b, a);
+  int bad = amhbi_cmp(g1, want) || amhbi_cmp(g2, want);
+  printf("gcd %s (%lu digits): %s\n", name, a->length, bad ? "FAILED" : "ok");
+  amhbi_free(2, g1, g2);
+  return bad;
+}
+
+static int
+check_cmp (const char *name, amhbq_t *q1, amhbq_t *q2, int8_t want)
+{
+  // 비교해도 약분 여부는 그대로여야 한다
+  uint8_t r1 = q1->reduced, r2 = q2->reduced;
+  int bad = amhbq_cmp(q1, q2) != want || amhbq_cmp(q2, q1) != -want
+            || q1->reduced != r1 || q2->reduced != r2;
+  printf("cmp %s: %s\n", name, bad ? "FAILED" : "ok");
+  return bad;
+}
+
+static int
+check ()
+{
+  int bad = 0;
+
+  // gcd(g x, g (x + 1)) = g; 이웃한 두 수는 서로소
+  amhbi_rand_t *rand = amhbi_rand_init(1);
+  uint64_t sizes[3] = {AMHBI_GCD_HALF, 2 * AMHBI_GCD_HALF, 5 * AMHBI_GCD_HALF};
+  int i; for (i = 0; i < 3; i++) {
+    amhbi_t *g = amhbi_urandomd(rand, sizes[i] / 2);
+    amhbi_t *x = amhbi_urandomd(rand, sizes[i]);
+    amhbi_t *y = amhbi_init_cpy(x);
+    amhbi_incr(y);
+    amhbi_t *a = amhbi_mult(g, x);
+    amhbi_t *b = amhbi_mult(g, y);
+    amhbi_t *na = amhbi_negate(a);
+    bad |= check_gcd("g x, g (x + 1)", a, b, g);
+    bad |= check_gcd("-g x, g (x + 1)", na, b, g);
+    amhbi_free(6, g, x, y, a, b, na);
+  }
+  amhbi_rand_free(rand);
+
+  // gcd(F_m, F_n) = F_gcd(m, n); 이웃한 피보나치 수는 유클리드의 최악
+  amhbi_t *f0 = amhbi_init_zero(), *f1 = amhbi_init_int(1);
+  amhbi_t *f6000 = NULL, *f24000 = NULL, *f29999 = NULL, *f30000 = NULL;
+  uint64_t n; for (n = 1; n < 30000; n++) {
+    amhbi_t *f2 = amhbi_add(f0, f1);
+    amhbi_free(1, f0);
+    f0 = f1;
+    f1 = f2;
+    if (n + 1 == 6000) f6000 = amhbi_init_cpy(f1);
+    if (n + 1 == 24000) f24000 = amhbi_init_cpy(f1);
+  }
+  f29999 = f0;
+  f30000 = f1;
+  amhbi_t *one = amhbi_init_int(1);
+  bad |= check_gcd("F_30000, F_24000", f30000, f24000, f6000);
+  bad |= check_gcd("F_30000, F_29999", f30000, f29999, one);
+  amhbi_free(5, f6000, f24000, f29999, f30000, one);
+
+  // 게으른 곱은 약분하지 않는다: -210/210, -35/35, 175/42
+  amhbq_t *a = amhbq_init_str("-6/35"), *b = amhbq_init_str("35/6");
+  amhbq_t *c = amhbq_init_str("5/7"), *d = amhbq_init_str("-7/5");
+  amhbq_set_lazy(a, 1);
+  amhbq_set_lazy(b, 1);
+  amhbq_set_lazy(c, 1);
+  amhbq_set_lazy(d, 1);
+  amhbq_t *ab = amhbq_mult(a, b), *cd = amhbq_mult(c, d), *bc = amhbq_mult(b, c);
+  amhbq_t *ad = amhbq_mult(a, d), *cc = amhbq_init_cpy(bc);
+  amhbq_canon(cc);
+  if (ab->reduced || cd->reduced || bc->reduced || ad->reduced) {
+    puts("lazy products reduced: FAILED");
+    bad = 1;
+  }
+  bad |= check_cmp("-210/210, -35/35", ab, cd, 0);
+  bad |= check_cmp("-210/210, 175/42", ab, bc, -1);
+  bad |= check_cmp("-35/35, 42/175", cd, ad, -1);
+  bad |= check_cmp("175/42, 42/175", bc, ad, 1);
+  bad |= check_cmp("175/42, 25/6", bc, cc, 0);
+  amhbq_free(9, a, b, c, d, ab, cd, bc, ad, cc);
+
+  puts(bad ? "FAILED" : "ok");
+  return bad;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  // 옵션: --check 이면 검사, --rpn 이면 후위식, 파일 이름이 '-'면 표준 입력
+  if (argc < 2) return demo();
+  if (argc == 2 && !strcmp(argv[1], "--check")) return check();
+  uint8_t rpn = 0;
+  int i = 1;
+  if (!strcmp(argv[i], "--rpn")) {
+    rpn = 1;
+    i++;
+  }
+  if (i + 1 != argc) {
+    fprintf(stderr, "usage: %s [--check | [--rpn] file|-]\n", argv[0]);
+    return 1;
+  }
+  FILE *in = (!strcmp(argv[i], "-")) ? stdin : fopen(argv[i], "r");
+  if (!in) {
+    perror(argv[i]);
+    return 1;
+  }
+  int res = stream(in, rpn);
+  if (in != stdin) fclose(in);
+  return res;
 }